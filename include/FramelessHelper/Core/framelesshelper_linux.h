@@ -103,6 +103,27 @@ using xcb_button_press_event_t = struct xcb_button_press_event_t
 };
 using xcb_button_release_event_t = xcb_button_press_event_t;
 
+using xcb_generic_event_t = struct xcb_generic_event_t
+{
+    uint8_t response_type;
+    uint8_t pad0;
+    uint16_t sequence;
+    uint32_t pad[7];
+    uint32_t full_sequence;
+};
+
+using xcb_property_notify_event_t = struct xcb_property_notify_event_t
+{
+    uint8_t response_type;
+    uint8_t pad0;
+    uint16_t sequence;
+    xcb_window_t window;
+    xcb_atom_t atom;
+    xcb_timestamp_t time;
+    uint8_t state;
+    uint8_t pad1[3];
+};
+
 using xcb_void_cookie_t = struct xcb_void_cookie_t
 {
     unsigned int sequence;
@@ -177,6 +198,8 @@ using xcb_list_properties_reply_t = struct xcb_list_properties_reply_t
 [[maybe_unused]] inline constexpr const auto XCB_BUTTON_INDEX_3 = 3;
 [[maybe_unused]] inline constexpr const auto XCB_BUTTON_RELEASE = 5;
 [[maybe_unused]] inline constexpr const auto XCB_CLIENT_MESSAGE = 33;
+[[maybe_unused]] inline constexpr const auto XCB_PROPERTY_NOTIFY = 28;
+[[maybe_unused]] inline constexpr const auto XCB_PROPERTY_DELETE = 1;
 [[maybe_unused]] inline constexpr const auto XCB_EVENT_MASK_STRUCTURE_NOTIFY = 131072;
 [[maybe_unused]] inline constexpr const auto XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT = 1048576;
 [[maybe_unused]] inline constexpr const auto XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY = 524288;
@@ -208,6 +231,24 @@ using xcb_list_properties_reply_t = struct xcb_list_properties_reply_t
 [[maybe_unused]] inline constexpr const char ATOM_NET_WM_DEEPIN_BLUR_REGION_ROUNDED[] = "_NET_WM_DEEPIN_BLUR_REGION_ROUNDED";
 [[maybe_unused]] inline constexpr const char ATOM_UTF8_STRING[] = "UTF8_STRING";
 
+// The atoms above, in the same order. They are all interned in one go, see Utils::x11_atom().
+enum class X11Atom : int
+{
+    NetSupported = 0,
+    NetWmName,
+    NetWmMoveResize,
+    NetSupportingWmCheck,
+    NetKdeCompositeToggling,
+    KdeNetWmBlurBehindRegion,
+    GtkShowWindowMenu,
+    DeepinNoTitleBar,
+    DeepinForceDecorate,
+    NetWmDeepinBlurRegionMask,
+    NetWmDeepinBlurRegionRounded,
+    Utf8String,
+    Count
+};
+
 extern "C"
 {
 
@@ -265,6 +306,13 @@ xcb_delete_property_checked(
     xcb_atom_t property
 );
 
+FRAMELESSHELPER_CORE_API xcb_void_cookie_t
+xcb_delete_property(
+    xcb_connection_t *connection,
+    xcb_window_t window,
+    xcb_atom_t property
+);
+
 FRAMELESSHELPER_CORE_API xcb_get_property_cookie_t
 xcb_get_property(
     xcb_connection_t *connection,
@@ -416,6 +464,17 @@ struct _GValue
 [[maybe_unused]] inline constexpr const char GTK_THEME_NAME_ENV_VAR[] = "GTK_THEME";
 [[maybe_unused]] inline constexpr const char GTK_THEME_NAME_PROP[] = "gtk-theme-name";
 [[maybe_unused]] inline constexpr const char GTK_THEME_PREFER_DARK_PROP[] = "gtk-application-prefer-dark-theme";
+[[maybe_unused]] inline constexpr const char GTK_SETTINGS_INI_FILE[] = "gtk-3.0/settings.ini";
+[[maybe_unused]] inline constexpr const char GTK_SETTINGS_INI_GROUP[] = "Settings";
+
+[[maybe_unused]] inline constexpr const char XDG_PORTAL_SERVICE[] = "org.freedesktop.portal.Desktop";
+[[maybe_unused]] inline constexpr const char XDG_PORTAL_PATH[] = "/org/freedesktop/portal/desktop";
+[[maybe_unused]] inline constexpr const char XDG_PORTAL_SETTINGS_INTERFACE[] = "org.freedesktop.portal.Settings";
+[[maybe_unused]] inline constexpr const char XDG_PORTAL_SETTINGS_READ_METHOD[] = "Read";
+[[maybe_unused]] inline constexpr const char XDG_PORTAL_SETTING_CHANGED_SIGNAL[] = "SettingChanged";
+[[maybe_unused]] inline constexpr const char XDG_APPEARANCE_NAMESPACE[] = "org.freedesktop.appearance";
+[[maybe_unused]] inline constexpr const char XDG_APPEARANCE_COLOR_SCHEME_KEY[] = "color-scheme";
+[[maybe_unused]] inline constexpr const char XDG_APPEARANCE_ACCENT_COLOR_KEY[] = "accent-color";
 
 #if 0
 extern "C"
@@ -30,6 +30,8 @@ FRAMELESSHELPER_BEGIN_NAMESPACE
 
 Q_DECLARE_LOGGING_CATEGORY(lcFramelessHelperQt)
 
+struct QtHelperData;
+
 class FRAMELESSHELPER_CORE_API FramelessHelperQt : public QObject
 {
     Q_OBJECT
@@ -40,10 +42,14 @@ public:
     ~FramelessHelperQt() override;
 
     static void addWindow(const Global::SystemParameters &params);
+    static void addWindow(Global::WindowAdapter *adapter);
     static void removeWindow(const WId windowId);
 
 protected:
     Q_NODISCARD bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+    std::unique_ptr<QtHelperData> m_data;
 };
 
 FRAMELESSHELPER_END_NAMESPACE
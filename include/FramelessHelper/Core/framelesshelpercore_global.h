@@ -28,6 +28,9 @@
 #include <QtCore/qmath.h>
 #include <QtCore/qpoint.h>
 #include <QtCore/qsize.h>
+#include <QtCore/qrect.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qpair.h>
 #include <QtCore/qobject.h>
 #include <QtCore/qpointer.h>
 #include <QtCore/qloggingcategory.h>
@@ -236,6 +239,8 @@ Q_NAMESPACE_EXPORT(FRAMELESSHELPER_CORE_API)
     = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DONT_OVERRIDE_CURSOR");
 [[maybe_unused]] inline const QByteArray kDontToggleMaximizeVar
     = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DONT_TOGGLE_MAXIMIZE");
+[[maybe_unused]] inline const QByteArray kDisableGtkThemeBackendVar
+    = FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DISABLE_GTK_THEME_BACKEND");
 
 enum class Option
 {
@@ -247,7 +252,10 @@ enum class Option
     CenterWindowBeforeShow = 5,
     EnableBlurBehindWindow = 6,
     ForceNonNativeBackgroundBlur = 7,
-    DisableLazyInitializationForMicaMaterial = 8
+    DisableLazyInitializationForMicaMaterial = 8,
+    DisableDownscalingForMicaMaterial = 9,
+    PauseMicaMaterialWhileMoving = 10,
+    DisableGtkThemeBackend = 11
 };
 Q_ENUM_NS(Option)
 
@@ -402,6 +410,40 @@ enum class WindowCornerStyle
 };
 Q_ENUM_NS(WindowCornerStyle)
 
+enum class HitTestZone
+{
+    Client = 0,
+    ResizeBorder = 1,
+    Caption = 2,
+    SystemButton = 3,
+    HitTestVisible = 4,
+    FrameBorder = 5 // macOS only: the system resizes the window here, leave it alone.
+};
+Q_ENUM_NS(HitTestZone)
+
+enum class CacheTrimLevel
+{
+    Unused = 0, // Only release the caches that nothing is using at the moment
+    All = 1 // Release everything, it will be regenerated when it's needed again
+};
+Q_ENUM_NS(CacheTrimLevel)
+
+enum class MicaBlurAlgorithm
+{
+    Exponential = 0, // The two sided exponential blur of QGraphicsBlurEffect
+    Box = 1, // Several box blurs in a row, costs the same for any radius
+    DualKawase = 2 // A downsample/upsample pyramid, the cheapest one for large radii
+};
+Q_ENUM_NS(MicaBlurAlgorithm)
+
+enum class MicaBlurQuality
+{
+    Speed = 0,
+    Balanced = 1,
+    Quality = 2
+};
+Q_ENUM_NS(MicaBlurQuality)
+
 struct VersionNumber
 {
     int major = 0;
@@ -560,6 +602,71 @@ struct SystemParameters
     }
 };
 
+// Everything needed to classify a point of the window, in window coordinates.
+// Frontends build this once and keep it until one of the involved geometries
+// changes, so that classifying a mouse event is only a few rectangle lookups.
+struct HitTestGeometry
+{
+    QSize windowSize = {};
+    QRect titleBarRect = {};
+    QList<QPair<SystemButtonType, QRect>> systemButtons = {};
+    QList<QRect> hitTestVisibleRects = {};
+};
+
+struct HitTestResult
+{
+    HitTestZone zone = HitTestZone::Client;
+    Qt::Edges edges = {}; // Only set for HitTestZone::ResizeBorder.
+    SystemButtonType button = SystemButtonType::Unknown; // Only set for HitTestZone::SystemButton.
+};
+
+// An opt-in alternative to SystemParameters: instead of filling 26 separate
+// std::function objects, a frontend implements this interface once, and every
+// call from the core module goes through a single vtable.
+class FRAMELESSHELPER_CORE_API WindowAdapter
+{
+    Q_DISABLE_COPY_MOVE(WindowAdapter)
+
+public:
+    WindowAdapter() = default;
+    virtual ~WindowAdapter();
+
+    [[nodiscard]] virtual Qt::WindowFlags getWindowFlags() const = 0;
+    virtual void setWindowFlags(const Qt::WindowFlags flags) = 0;
+    [[nodiscard]] virtual QSize getWindowSize() const = 0;
+    virtual void setWindowSize(const QSize &size) = 0;
+    [[nodiscard]] virtual QPoint getWindowPosition() const = 0;
+    virtual void setWindowPosition(const QPoint &pos) = 0;
+    [[nodiscard]] virtual QScreen *getWindowScreen() const = 0;
+    [[nodiscard]] virtual bool isWindowFixedSize() const = 0;
+    virtual void setWindowFixedSize(const bool value) = 0;
+    [[nodiscard]] virtual Qt::WindowState getWindowState() const = 0;
+    virtual void setWindowState(const Qt::WindowState state) = 0;
+    [[nodiscard]] virtual QWindow *getWindowHandle() const = 0;
+    [[nodiscard]] virtual QPoint windowToScreen(const QPoint &pos) const = 0;
+    [[nodiscard]] virtual QPoint screenToWindow(const QPoint &pos) const = 0;
+    [[nodiscard]] virtual bool isInsideSystemButtons(const QPoint &pos, SystemButtonType *button) const = 0;
+    [[nodiscard]] virtual bool isInsideTitleBarDraggableArea(const QPoint &pos) const = 0;
+    [[nodiscard]] virtual qreal getWindowDevicePixelRatio() const = 0;
+    virtual void setSystemButtonState(const SystemButtonType button, const ButtonState state) = 0;
+    [[nodiscard]] virtual WId getWindowId() const = 0;
+    [[nodiscard]] virtual bool shouldIgnoreMouseEvents(const QPoint &pos) const = 0;
+    virtual void showSystemMenu(const QPoint &pos) = 0;
+    virtual void setProperty(const QByteArray &name, const QVariant &value) = 0;
+    [[nodiscard]] virtual QVariant getProperty(const QByteArray &name, const QVariant &defaultValue) const = 0;
+    virtual void setCursor(const QCursor &cursor) = 0;
+    virtual void unsetCursor() = 0;
+    [[nodiscard]] virtual QObject *getWidgetHandle() const = 0;
+
+    // Classifies the given point in one go. The default implementation is built on top
+    // of the functions above, frontends which know their own geometry should override it.
+    [[nodiscard]] virtual HitTestResult classify(const QPoint &pos) const;
+
+    // Compatibility shims for the code paths which still work with SystemParameters.
+    [[nodiscard]] SystemParameters toSystemParameters();
+    [[nodiscard]] static std::unique_ptr<WindowAdapter> fromSystemParameters(const SystemParameters &params);
+};
+
 struct VersionInfo
 {
     int version = 0;
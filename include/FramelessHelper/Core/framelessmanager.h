@@ -55,11 +55,18 @@ public:
 
 public Q_SLOTS:
     void addWindow(const Global::SystemParameters &params);
+    void addWindow(Global::WindowAdapter *adapter);
     void removeWindow(const WId windowId);
+    // Meant to be called when the system is running low on memory.
+    void trimCaches(const Global::CacheTrimLevel level = Global::CacheTrimLevel::Unused);
 
 Q_SIGNALS:
     void systemThemeChanged();
     void wallpaperChanged();
+    // Linux only: the window manager (or what it supports) has changed, all the cached
+    // capabilities have been dropped, things like Utils::isBlurBehindWindowSupported()
+    // may give a different answer now.
+    void windowManagerChanged();
 
 private:
     QScopedPointer<FramelessManagerPrivate> d_ptr;
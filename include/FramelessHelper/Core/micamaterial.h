@@ -25,6 +25,7 @@
 #pragma once
 
 #include "framelesshelpercore_global.h"
+#include <QtGui/qregion.h>
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
@@ -55,8 +56,28 @@ public:
     Q_NODISCARD qreal noiseOpacity() const;
     void setNoiseOpacity(const qreal value);
 
+    // The number of threads the wallpaper blur is allowed to use, shared by all instances.
+    // Pass zero or a negative number to go back to QThread::idealThreadCount().
+    Q_NODISCARD static int blurThreadCount();
+    static void setBlurThreadCount(const int count);
+
+    // How long (in milliseconds) the blurred wallpaper is kept in memory after the last
+    // instance stopped painting. Pass a negative number to keep it forever.
+    Q_NODISCARD static int cacheIdleTimeout();
+    static void setCacheIdleTimeout(const int timeout);
+
+    // How the wallpaper is blurred, shared by all instances. Changing any of them
+    // regenerates the blurred wallpaper.
+    Q_NODISCARD static Global::MicaBlurAlgorithm blurAlgorithm();
+    static void setBlurAlgorithm(const Global::MicaBlurAlgorithm algorithm);
+
+    Q_NODISCARD static Global::MicaBlurQuality blurQuality();
+    static void setBlurQuality(const Global::MicaBlurQuality quality);
+
 public Q_SLOTS:
     void paint(QPainter *painter, const QSize &size, const QPoint &pos);
+    // Only paints the parts that intersect "exposedRegion", in the painter's coordinates.
+    void paintRegion(QPainter *painter, const QSize &size, const QPoint &pos, const QRegion &exposedRegion);
 
 Q_SIGNALS:
     void tintColorChanged();
@@ -26,6 +26,10 @@
 
 #include "framelesshelpercore_global.h"
 
+QT_BEGIN_NAMESPACE
+class QFileSystemWatcher;
+QT_END_NAMESPACE
+
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
 class FramelessManager;
@@ -52,15 +56,37 @@ public:
     Q_NODISCARD Global::WallpaperAspectStyle wallpaperAspectStyle() const;
 
     static void addWindow(const Global::SystemParameters &params);
+    static void addWindow(Global::WindowAdapter *adapter);
     static void removeWindow(const WId windowId);
 
     Q_INVOKABLE void notifySystemThemeHasChangedOrNot();
     Q_INVOKABLE void notifyWallpaperHasChangedOrNot();
+    Q_INVOKABLE void notifyWindowManagerHasChanged();
 
     Q_NODISCARD static bool usePureQtImplementation();
 
+#ifdef Q_OS_LINUX
+    Q_INVOKABLE void notifyDesktopThemeHasChanged();
+
+    // The desktop theme settings, read from GTK or the XDG desktop portal (see
+    // Utils::isGtkThemeBackendEnabled()). Once the backend has been asked to tell us
+    // about their changes they are only read again after such a notification, until
+    // then every call goes to the backend.
+    Q_NODISCARD static bool desktopPrefersDarkTheme();
+    Q_NODISCARD static QColor desktopAccentColor();
+    static void setDesktopThemeWatched(const bool value);
+    static void invalidateDesktopThemeCache();
+#endif
+
 private:
     void initialize();
+#ifdef Q_OS_LINUX
+    Q_NODISCARD bool watchXdgDesktopPortal();
+    Q_NODISCARD bool watchGtkSettingsIni();
+    void handleGtkSettingsIniChanged();
+    void handleGtkConfigDirectoryChanged();
+#endif
+    Q_NODISCARD static bool registerWindowId(const WId windowId);
 
 private:
     FramelessManager *q_ptr = nullptr;
@@ -71,6 +97,10 @@ private:
 #endif
     QString m_wallpaper = {};
     Global::WallpaperAspectStyle m_wallpaperAspectStyle = Global::WallpaperAspectStyle::Fill;
+#ifdef Q_OS_LINUX
+    QFileSystemWatcher *m_gtkSettingsIniWatcher = nullptr;
+    QString m_gtkSettingsIniSignature = {};
+#endif
 };
 
 FRAMELESSHELPER_END_NAMESPACE
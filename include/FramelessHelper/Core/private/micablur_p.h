@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "framelesshelpercore_global.h"
+#include <QtGui/qimage.h>
+
+QT_BEGIN_NAMESPACE
+class QPainter;
+class QThreadPool;
+QT_END_NAMESPACE
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+// The blur algorithms behind MicaMaterial. They are kept apart from it so that they can be
+// tested and measured on their own, see the "tests" directory.
+namespace MicaBlur
+{
+
+// The kernel the exponential blur uses for its row pass over 32-bit images. All of them
+// give exactly the same result, "Auto" picks the fastest one this CPU has.
+enum class RowKernel : quint8
+{
+    Auto = 0,
+    Scalar = 1,
+    SSE2 = 2,
+    AVX2 = 3
+};
+
+[[nodiscard]] FRAMELESSHELPER_CORE_API bool isRowKernelSupported(const RowKernel kernel);
+// Unsupported kernels are ignored.
+FRAMELESSHELPER_CORE_API void setRowKernel(const RowKernel kernel);
+
+// The threads all of the algorithms below split their work across.
+[[nodiscard]] FRAMELESSHELPER_CORE_API QThreadPool *threadPool();
+
+// All of them work in place on ARGB32_Premultiplied images, the exponential blur takes
+// RGB32, Indexed8 and Grayscale8 images as well.
+FRAMELESSHELPER_CORE_API void exponentialBlur(QImage &image, const qreal radius, const bool improvedQuality);
+FRAMELESSHELPER_CORE_API void boxBlur(QImage &image, const qreal radius, const int passes);
+[[nodiscard]] FRAMELESSHELPER_CORE_API QImage kawaseBlur(const QImage &image, const qreal radius,
+                                                         const Global::MicaBlurQuality quality);
+
+// Paints "image", blurred with the given algorithm, with "painter". The image itself may be
+// changed as well.
+FRAMELESSHELPER_CORE_API void blurImage(QPainter *painter, QImage &image, const qreal radius,
+                                        const Global::MicaBlurAlgorithm algorithm,
+                                        const Global::MicaBlurQuality quality);
+
+} // namespace MicaBlur
+
+FRAMELESSHELPER_END_NAMESPACE
@@ -25,7 +25,15 @@
 #pragma once
 
 #include "framelesshelpercore_global.h"
+#include <QtCore/qhash.h>
 #include <QtGui/qbrush.h>
+#include <QtGui/qimage.h>
+#include <QtGui/qregion.h>
+#include <memory>
+
+QT_BEGIN_NAMESPACE
+class QScreen;
+QT_END_NAMESPACE
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
@@ -44,22 +52,48 @@ public:
     Q_NODISCARD static MicaMaterialPrivate *get(MicaMaterial *q);
     Q_NODISCARD static const MicaMaterialPrivate *get(const MicaMaterial *q);
 
+    static void trimCaches(const Global::CacheTrimLevel level);
+    static void regenerateWallpaperTiles();
+
 public Q_SLOTS:
     void maybeGenerateBlurredWallpaper(const bool force = false);
     void updateMaterialBrush();
-    void paint(QPainter *painter, const QSize &size, const QPoint &pos);
+    void paint(QPainter *painter, const QSize &size, const QPoint &pos, const QRegion &exposedRegion);
+    void setActive(const bool value);
+
+Q_SIGNALS:
+    // Emitted in the thread of the instance, so that the users of the instance
+    // can release their own caches of what it has painted.
+    void cachesTrimmed(const Global::CacheTrimLevel level);
 
 private:
     void initialize();
-    void prepareGraphicsResources();
+    Q_NODISCARD std::shared_ptr<const QImage> surfaceForScreen(QScreen *screen, const QImage &tile, const quint64 tileRequest);
+    static void maybeGenerateWallpaperTile(QScreen *screen);
+    static void publishWallpaperTile(QScreen *screen, const quint64 request, const QImage &image);
+    Q_NODISCARD static bool isAnyInstanceActive();
+    static void scheduleIdleRelease();
 
 private:
+    // The blurred wallpaper tile of a screen with the tint already blended over it.
+    // Shared with all the other instances that have the same colors.
+    struct MicaSurface
+    {
+        std::shared_ptr<const QImage> image = nullptr;
+        quint64 tileRequest = 0;
+    };
+
     MicaMaterial *q_ptr = nullptr;
     QColor tintColor = {};
     qreal tintOpacity = 0.0;
     qreal noiseOpacity = 0.0;
     QBrush micaBrush = {};
+    QBrush noiseBrush = {};
+    QColor placeholderColor = {};
+    QColor materialColor = {}; // The fill color of the theme with the tint blended over it.
+    QHash<QScreen *, MicaSurface> surfaces = {};
     bool initialized = false;
+    bool active = false; // Guarded by the global mutex.
 };
 
 FRAMELESSHELPER_END_NAMESPACE
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "framelesshelpercore_global.h"
+#include <QtGui/qregion.h>
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
@@ -48,7 +49,7 @@ public:
     Q_NODISCARD static Global::WindowEdges getNativeBorderEdges();
 
 public Q_SLOTS:
-    void paint(QPainter *painter, const QSize &size, const bool active) const;
+    void paint(QPainter *painter, const QSize &size, const bool active, const QRegion &exposedRegion) const;
 
 private:
     void initialize();
@@ -0,0 +1,57 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "framelesshelpercore_global.h"
+#include "framelesshelper_linux.h"
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+// Collects X11 property writes and sends them together. XCB only buffers them, so the
+// whole batch costs one flush instead of one per request. Only writes are batched: none
+// of our property reads can be sent ahead of time, each of them either is the only one
+// or depends on the reply of the previous one. Anything still queued is flushed by the
+// destructor.
+class FRAMELESSHELPER_CORE_API X11RequestBatch
+{
+    Q_DISABLE_COPY_MOVE(X11RequestBatch)
+
+public:
+    explicit X11RequestBatch();
+    ~X11RequestBatch();
+
+    void setWindowProperty(const WId windowId, const xcb_atom_t prop, const xcb_atom_t type,
+                           const void *data, const quint32 data_len, const uint8_t format);
+    void clearWindowProperty(const WId windowId, const xcb_atom_t prop);
+
+    void flush();
+
+private:
+    xcb_connection_t *m_connection = nullptr;
+    bool m_hasWrites = false;
+};
+
+FRAMELESSHELPER_END_NAMESPACE
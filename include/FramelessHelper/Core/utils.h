@@ -47,6 +47,9 @@ namespace Utils
     Qt::CursorShape calculateCursorShape(const QWindow *window, const QPoint &pos);
 [[nodiscard]] FRAMELESSHELPER_CORE_API
     Qt::Edges calculateWindowEdges(const QWindow *window, const QPoint &pos);
+[[nodiscard]] FRAMELESSHELPER_CORE_API Qt::CursorShape calculateCursorShape(const Qt::Edges edges);
+[[nodiscard]] FRAMELESSHELPER_CORE_API Global::HitTestResult classifyHitTestZone
+    (const Global::HitTestGeometry &geometry, const QPoint &pos, const bool resizable);
 FRAMELESSHELPER_CORE_API void startSystemMove(QWindow *window, const QPoint &globalPos);
 FRAMELESSHELPER_CORE_API void startSystemResize(QWindow *window, const Qt::Edges edges, const QPoint &globalPos);
 [[nodiscard]] FRAMELESSHELPER_CORE_API QString getSystemButtonIconCode(const Global::SystemButtonType button);
@@ -163,13 +166,18 @@ FRAMELESSHELPER_CORE_API void setWindowProperty
      const void *data, const quint32 data_len, const uint8_t format);
 FRAMELESSHELPER_CORE_API void clearWindowProperty(const WId windowId, const xcb_atom_t prop);
 [[nodiscard]] FRAMELESSHELPER_CORE_API xcb_atom_t internAtom(const char *name);
+[[nodiscard]] FRAMELESSHELPER_CORE_API xcb_atom_t x11_atom(const X11Atom atom);
 [[nodiscard]] FRAMELESSHELPER_CORE_API QString getWindowManagerName();
 [[nodiscard]] FRAMELESSHELPER_CORE_API bool isSupportedByWindowManager(const xcb_atom_t atom);
 [[nodiscard]] FRAMELESSHELPER_CORE_API bool isSupportedByRootWindow(const xcb_atom_t atom);
+FRAMELESSHELPER_CORE_API void registerWindowManagerChangeNotification();
 [[nodiscard]] FRAMELESSHELPER_CORE_API bool tryHideSystemTitleBar(const WId windowId, const bool hide = true);
 FRAMELESSHELPER_CORE_API void openSystemMenu(const WId windowId, const QPoint &globalPos);
 [[nodiscard]] FRAMELESSHELPER_CORE_API bool shouldAppsUseDarkMode_linux();
 [[nodiscard]] FRAMELESSHELPER_CORE_API QColor getWmThemeColor();
+[[nodiscard]] FRAMELESSHELPER_CORE_API bool isGtkThemeBackendEnabled();
+[[nodiscard]] FRAMELESSHELPER_CORE_API bool queryDarkThemePreference();
+[[nodiscard]] FRAMELESSHELPER_CORE_API QColor queryAccentColor();
 FRAMELESSHELPER_CORE_API void sendMoveResizeMessage
     (const WId windowId, const uint32_t action, const QPoint &globalPos, const Qt::MouseButton button = Qt::LeftButton);
 [[nodiscard]] FRAMELESSHELPER_CORE_API bool isCustomDecorationSupported();
@@ -25,6 +25,7 @@
 #pragma once
 
 #include "framelesshelpercore_global.h"
+#include <QtGui/qregion.h>
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
@@ -64,6 +65,8 @@ public:
 
 public Q_SLOTS:
     void paint(QPainter *painter, const QSize &size, const bool active) const;
+    // Only paints the edges that intersect "exposedRegion", in the painter's coordinates.
+    void paintRegion(QPainter *painter, const QSize &size, const bool active, const QRegion &exposedRegion) const;
     void setThickness(const int value);
     void setEdges(const Global::WindowEdges value);
     void setActiveColor(const QColor &value);
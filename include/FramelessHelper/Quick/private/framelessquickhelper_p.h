@@ -36,12 +36,14 @@ class FramelessQuickHelper;
 class QuickMicaMaterial;
 class QuickWindowBorder;
 struct QuickHelperData;
+class QuickWindowAdapter;
 
 class FRAMELESSHELPER_QUICK_API FramelessQuickHelperPrivate : public QObject
 {
     Q_OBJECT
     Q_DECLARE_PUBLIC(FramelessQuickHelper)
     Q_DISABLE_COPY_MOVE(FramelessQuickHelperPrivate)
+    friend class QuickWindowAdapter;
 
 public:
     explicit FramelessQuickHelperPrivate(FramelessQuickHelper *q);
@@ -89,6 +91,12 @@ private:
     Q_NODISCARD QRect mapItemGeometryToScene(const QQuickItem * const item) const;
     Q_NODISCARD bool isInSystemButtons(const QPoint &pos, QuickGlobal::SystemButtonType *button) const;
     Q_NODISCARD bool isInTitleBarDraggableArea(const QPoint &pos) const;
+    Q_NODISCARD Global::HitTestResult classify(const QPoint &pos) const;
+    Q_NODISCARD Global::HitTestResult hitTest(const QPoint &pos, const bool resizable) const;
+    Q_NODISCARD Global::HitTestGeometry calculateHitTestGeometry(const QuickHelperData &data) const;
+    void trackItemGeometry(QQuickItem *item);
+    void handleItemParentChanged(QQuickItem *parent);
+    void invalidateHitTestGeometry();
     Q_NODISCARD bool shouldIgnoreMouseEvents(const QPoint &pos) const;
     void setSystemButtonState(const QuickGlobal::SystemButtonType button, const QuickGlobal::ButtonState state);
     Q_NODISCARD QuickHelperData getWindowData() const;
@@ -101,6 +109,7 @@ private:
     bool m_blurBehindWindowEnabled = false;
     std::optional<bool> m_extendIntoTitleBar = std::nullopt;
     bool m_destroying = false;
+    std::unique_ptr<Global::WindowAdapter> m_windowAdapter = nullptr;
 };
 
 FRAMELESSHELPER_END_NAMESPACE
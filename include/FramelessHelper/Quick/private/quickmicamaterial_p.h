@@ -29,7 +29,6 @@
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
 class QuickMicaMaterial;
-class WallpaperImageNode;
 
 class FRAMELESSHELPER_QUICK_API QuickMicaMaterialPrivate : public QObject
 {
@@ -44,19 +43,24 @@ public:
     Q_NODISCARD static QuickMicaMaterialPrivate *get(QuickMicaMaterial *q);
     Q_NODISCARD static const QuickMicaMaterialPrivate *get(const QuickMicaMaterial *q);
 
+    // Only called in the GUI thread.
+    static void scheduleWallpaperImagesRegeneration(const bool repaintAll);
+
 public Q_SLOTS:
     void rebindWindow();
     void forceRegenerateWallpaperImageCache();
-    void appendNode(WallpaperImageNode *node);
 
 private:
     void initialize();
+    void updateScreens();
+    static void regenerateWallpaperImages();
+    static void trimCaches(const Global::CacheTrimLevel level);
 
 private:
     QuickMicaMaterial *q_ptr = nullptr;
     QMetaObject::Connection m_rootWindowXChangedConnection = {};
     QMetaObject::Connection m_rootWindowYChangedConnection = {};
-    QList<QPointer<WallpaperImageNode>> m_nodes = {};
+    QMetaObject::Connection m_rootWindowVisibleChangedConnection = {};
 };
 
 FRAMELESSHELPER_END_NAMESPACE
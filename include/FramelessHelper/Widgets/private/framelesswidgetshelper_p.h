@@ -31,6 +31,8 @@ FRAMELESSHELPER_BEGIN_NAMESPACE
 
 class FramelessWidgetsHelper;
 struct WidgetsHelperData;
+struct WidgetsHelperWindowData;
+class WidgetsWindowAdapter;
 class WidgetsSharedHelper;
 class MicaMaterial;
 class WindowBorderPainter;
@@ -40,6 +42,7 @@ class FRAMELESSHELPER_WIDGETS_API FramelessWidgetsHelperPrivate : public QObject
     Q_OBJECT
     Q_DECLARE_PUBLIC(FramelessWidgetsHelper)
     Q_DISABLE_COPY_MOVE(FramelessWidgetsHelperPrivate)
+    friend class WidgetsWindowAdapter;
 
 public:
     explicit FramelessWidgetsHelperPrivate(FramelessWidgetsHelper *q);
@@ -90,17 +93,24 @@ private:
     Q_NODISCARD QRect mapWidgetGeometryToScene(const QWidget * const widget) const;
     Q_NODISCARD bool isInSystemButtons(const QPoint &pos, Global::SystemButtonType *button) const;
     Q_NODISCARD bool isInTitleBarDraggableArea(const QPoint &pos) const;
+    Q_NODISCARD Global::HitTestResult classify(const QPoint &pos) const;
+    Q_NODISCARD Global::HitTestResult hitTest(const QPoint &pos, const bool resizable) const;
+    Q_NODISCARD Global::HitTestGeometry calculateHitTestGeometry(const WidgetsHelperData &data) const;
+    void trackWidgetGeometry(QWidget *widget);
     Q_NODISCARD bool shouldIgnoreMouseEvents(const QPoint &pos) const;
     void setSystemButtonState(const Global::SystemButtonType button, const Global::ButtonState state);
     Q_NODISCARD QWidget *findTopLevelWindow() const;
-    Q_NODISCARD WidgetsHelperData getWindowData() const;
-    Q_NODISCARD WidgetsHelperData *getWindowDataMutable() const;
+    Q_NODISCARD std::shared_ptr<const WidgetsHelperData> getWindowData() const;
+    Q_NODISCARD static std::shared_ptr<WidgetsHelperWindowData> findOrCreateWindowData(const WId windowId);
+    Q_NODISCARD WidgetsHelperWindowData *currentWindowData(const bool create) const;
 
 private:
     FramelessWidgetsHelper *q_ptr = nullptr;
     QColor m_savedWindowBackgroundColor = {};
     bool m_blurBehindWindowEnabled = false;
     QPointer<QWidget> m_window = nullptr;
+    mutable std::shared_ptr<WidgetsHelperWindowData> m_windowData = nullptr;
+    std::unique_ptr<Global::WindowAdapter> m_windowAdapter = nullptr;
     bool m_destroying = false;
 };
 
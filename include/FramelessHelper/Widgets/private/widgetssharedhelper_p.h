@@ -29,6 +29,7 @@
 
 QT_BEGIN_NAMESPACE
 class QPaintEvent;
+class QTimer;
 QT_END_NAMESPACE
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
@@ -64,6 +65,7 @@ private Q_SLOTS:
 private:
     void changeEventHandler(QEvent *event);
     void paintEventHandler(QPaintEvent *event);
+    void scheduleMicaRepaint(const bool moving);
 
 Q_SIGNALS:
     void micaEnabledChanged();
@@ -81,6 +83,9 @@ private:
     bool m_micaEnabled = false;
     MicaMaterial *m_micaMaterial = nullptr;
     QMetaObject::Connection m_micaRedrawConnection = {};
+    QTimer *m_micaRepaintTimer = nullptr;
+    QPoint m_micaOrigin = {};
+    bool m_micaOriginFrozen = false;
     qreal m_screenDpr = 0.0;
     QMetaObject::Connection m_screenDpiChangeConnection = {};
     WindowBorderPainter *m_borderPainter = nullptr;
@@ -30,6 +30,7 @@ HEADERS += \
     $$CORE_PRIV_INC_DIR/chromepalette_p.h \
     $$CORE_PRIV_INC_DIR/framelessconfig_p.h \
     $$CORE_PRIV_INC_DIR/framelessmanager_p.h \
+    $$CORE_PRIV_INC_DIR/micablur_p.h \
     $$CORE_PRIV_INC_DIR/micamaterial_p.h \
     $$CORE_PRIV_INC_DIR/sysapiloader_p.h \
     $$CORE_PRIV_INC_DIR/windowborderpainter_p.h
@@ -40,6 +41,7 @@ SOURCES += \
     $$CORE_SRC_DIR/framelesshelper_qt.cpp \
     $$CORE_SRC_DIR/framelessmanager.cpp \
     $$CORE_SRC_DIR/framelesshelpercore_global.cpp \
+    $$CORE_SRC_DIR/micablur.cpp \
     $$CORE_SRC_DIR/micamaterial.cpp \
     $$CORE_SRC_DIR/sysapiloader.cpp \
     $$CORE_SRC_DIR/utils.cpp \
@@ -64,14 +66,24 @@ win32 {
 }
 
 unix:!macx {
-    CONFIG += link_pkgconfig
-    PKGCONFIG += gtk+-3.0
-    DEFINES += GDK_VERSION_MIN_REQUIRED=GDK_VERSION_3_6
+    framelesshelper_no_gtk {
+        DEFINES += FRAMELESSHELPER_CORE_NO_GTK
+    } else {
+        CONFIG += link_pkgconfig
+        PKGCONFIG += gtk+-3.0
+        DEFINES += GDK_VERSION_MIN_REQUIRED=GDK_VERSION_3_6
+    }
+    qtHaveModule(dbus) {
+        QT += dbus
+        DEFINES += FRAMELESSHELPER_CORE_HAS_DBUS
+    }
     HEADERS += \
-        $$CORE_PUB_INC_DIR/framelesshelper_linux.h
+        $$CORE_PUB_INC_DIR/framelesshelper_linux.h \
+        $$CORE_PRIV_INC_DIR/x11requestbatch_p.h
     SOURCES += \
         $$CORE_SRC_DIR/utils_linux.cpp \
-        $$CORE_SRC_DIR/platformsupport_linux.cpp
+        $$CORE_SRC_DIR/platformsupport_linux.cpp \
+        $$CORE_SRC_DIR/x11requestbatch.cpp
 }
 
 macx {
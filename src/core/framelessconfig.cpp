@@ -70,7 +70,13 @@ static const struct
     {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_FORCE_NON_NATIVE_BACKGROUND_BLUR"),
       FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/ForceNonNativeBackgroundBlur")},
     {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DISABLE_LAZY_INITIALIZATION_FOR_MICA_MATERIAL"),
-      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/DisableLazyInitializationForMicaMaterial")}
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/DisableLazyInitializationForMicaMaterial")},
+    {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DISABLE_DOWNSCALING_FOR_MICA_MATERIAL"),
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/DisableDownscalingForMicaMaterial")},
+    {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_PAUSE_MICA_MATERIAL_WHILE_MOVING"),
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/PauseMicaMaterialWhileMoving")},
+    {FRAMELESSHELPER_BYTEARRAY_LITERAL("FRAMELESSHELPER_DISABLE_GTK_THEME_BACKEND"),
+      FRAMELESSHELPER_BYTEARRAY_LITERAL("Options/DisableGtkThemeBackend")}
 };
 
 static constexpr const auto OptionCount = std::size(OptionsTable);
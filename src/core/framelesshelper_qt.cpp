@@ -51,8 +51,9 @@ using namespace Global;
 
 struct QtHelperData
 {
-    SystemParameters params = {};
-    FramelessHelperQt *eventFilter = nullptr;
+    WindowAdapter *adapter = nullptr;
+    // Only used when the window was registered through the SystemParameters interface.
+    std::unique_ptr<WindowAdapter> ownedAdapter = nullptr;
     bool cursorShapeChanged = false;
     bool leftButtonPressed = false;
 };
@@ -60,12 +61,16 @@ struct QtHelperData
 struct QtHelper
 {
     QMutex mutex;
-    QHash<WId, QtHelperData> data = {};
+    // Each window has its own event filter object, which owns the data of that window.
+    QHash<WId, FramelessHelperQt *> eventFilters = {};
 };
 
 Q_GLOBAL_STATIC(QtHelper, g_qtHelper)
 
-FramelessHelperQt::FramelessHelperQt(QObject *parent) : QObject(parent) {}
+FramelessHelperQt::FramelessHelperQt(QObject *parent)
+    : QObject(parent), m_data(std::make_unique<QtHelperData>())
+{
+}
 
 FramelessHelperQt::~FramelessHelperQt() = default;
 
@@ -75,28 +80,45 @@ void FramelessHelperQt::addWindow(const SystemParameters &params)
     if (!params.isValid()) {
         return;
     }
-    const WId windowId = params.getWindowId();
+    std::unique_ptr<WindowAdapter> adapter = WindowAdapter::fromSystemParameters(params);
+    WindowAdapter * const rawAdapter = adapter.get();
+    addWindow(rawAdapter);
+    // Hand over the ownership to the event filter, it lives exactly as long as the registration.
+    const QMutexLocker locker(&g_qtHelper()->mutex);
+    if (const auto eventFilter = g_qtHelper()->eventFilters.value(params.getWindowId())) {
+        if (eventFilter->m_data->adapter == rawAdapter) {
+            eventFilter->m_data->ownedAdapter = std::move(adapter);
+        }
+    }
+}
+
+void FramelessHelperQt::addWindow(WindowAdapter *adapter)
+{
+    Q_ASSERT(adapter);
+    if (!adapter) {
+        return;
+    }
+    const WId windowId = adapter->getWindowId();
     g_qtHelper()->mutex.lock();
-    if (g_qtHelper()->data.contains(windowId)) {
+    if (g_qtHelper()->eventFilters.contains(windowId)) {
         g_qtHelper()->mutex.unlock();
         return;
     }
-    QtHelperData data = {};
-    data.params = params;
-    QWindow *window = params.getWindowHandle();
+    QWindow *window = adapter->getWindowHandle();
     // Give it a parent so that it can be deleted even if we forget to do so.
-    data.eventFilter = new FramelessHelperQt(window);
-    g_qtHelper()->data.insert(windowId, data);
+    const auto eventFilter = new FramelessHelperQt(window);
+    eventFilter->m_data->adapter = adapter;
+    g_qtHelper()->eventFilters.insert(windowId, eventFilter);
     g_qtHelper()->mutex.unlock();
-    const auto shouldApplyFramelessFlag = [&params]() -> bool {
+    const auto shouldApplyFramelessFlag = [adapter]() -> bool {
 #ifdef Q_OS_MACOS
-        const auto widget = params.getWidgetHandle();
+        const auto widget = adapter->getWidgetHandle();
         return (widget && widget->isWidgetType());
 #elif defined(Q_OS_LINUX)
-        Q_UNUSED(params);
+        Q_UNUSED(adapter);
         return !Utils::isCustomDecorationSupported();
 #else // Windows
-        Q_UNUSED(params);
+        Q_UNUSED(adapter);
         return true;
 #endif // Q_OS_MACOS
     }();
@@ -104,7 +126,7 @@ void FramelessHelperQt::addWindow(const SystemParameters &params)
     window->setProperty("_q_mac_wantsLayer", 1);
 #endif // (defined(Q_OS_MACOS) && (QT_VERSION < QT_VERSION_CHECK(6, 0, 0)))
     if (shouldApplyFramelessFlag) {
-        params.setWindowFlags(params.getWindowFlags() | Qt::FramelessWindowHint);
+        adapter->setWindowFlags(adapter->getWindowFlags() | Qt::FramelessWindowHint);
     } else {
 #ifdef Q_OS_LINUX
         Q_UNUSED(Utils::tryHideSystemTitleBar(windowId, true));
@@ -112,7 +134,7 @@ void FramelessHelperQt::addWindow(const SystemParameters &params)
         Utils::setSystemTitleBarVisible(windowId, false);
 #endif // Q_OS_LINUX
     }
-    window->installEventFilter(data.eventFilter);
+    window->installEventFilter(eventFilter);
     FramelessHelper::Core::setApplicationOSThemeAware();
 }
 
@@ -123,16 +145,15 @@ void FramelessHelperQt::removeWindow(const WId windowId)
         return;
     }
     const QMutexLocker locker(&g_qtHelper()->mutex);
-    if (!g_qtHelper()->data.contains(windowId)) {
+    if (!g_qtHelper()->eventFilters.contains(windowId)) {
         return;
     }
-    if (const auto eventFilter = g_qtHelper()->data.value(windowId).eventFilter) {
+    if (const auto eventFilter = g_qtHelper()->eventFilters.take(windowId)) {
         if (QWindow * const window = Utils::findWindow(windowId)) {
             window->removeEventFilter(eventFilter);
         }
         delete eventFilter;
     }
-    g_qtHelper()->data.remove(windowId);
 #ifdef Q_OS_MACOS
     Utils::removeWindowProxy(windowId);
 #endif
@@ -168,15 +189,15 @@ bool FramelessHelperQt::eventFilter(QObject *object, QEvent *event)
         && (type != QEvent::MouseButtonDblClick) && (type != QEvent::MouseMove)) {
         return QObject::eventFilter(object, event);
     }
-    const auto window = qobject_cast<QWindow *>(object);
-    const WId windowId = window->winId();
-    g_qtHelper()->mutex.lock();
-    if (!g_qtHelper()->data.contains(windowId)) {
-        g_qtHelper()->mutex.unlock();
+    // This object is only installed on the window it has been created for, and it
+    // owns the data of that window, so there's no need to look anything up here.
+    const auto window = static_cast<QWindow *>(object);
+    QtHelperData &data = *m_data;
+    WindowAdapter * const adapter = data.adapter;
+    Q_ASSERT(adapter);
+    if (!adapter) {
         return QObject::eventFilter(object, event);
     }
-    const QtHelperData data = g_qtHelper()->data.value(windowId);
-    g_qtHelper()->mutex.unlock();
     const auto mouseEvent = static_cast<QMouseEvent *>(event);
     const Qt::MouseButton button = mouseEvent->button();
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
@@ -186,21 +207,19 @@ bool FramelessHelperQt::eventFilter(QObject *object, QEvent *event)
     const QPoint scenePos = mouseEvent->windowPos().toPoint();
     const QPoint globalPos = mouseEvent->screenPos().toPoint();
 #endif
-    const bool windowFixedSize = data.params.isWindowFixedSize();
-    const bool ignoreThisEvent = data.params.shouldIgnoreMouseEvents(scenePos);
-    const bool insideTitleBar = data.params.isInsideTitleBarDraggableArea(scenePos);
-    const bool dontOverrideCursor = data.params.getProperty(kDontOverrideCursorVar, false).toBool();
-    const bool dontToggleMaximize = data.params.getProperty(kDontToggleMaximizeVar, false).toBool();
+    const bool windowFixedSize = adapter->isWindowFixedSize();
+    // One classification answers everything we need to know about this position.
+    const HitTestResult hitTest = adapter->classify(scenePos);
+    const bool insideTitleBar = (hitTest.zone == HitTestZone::Caption);
+    const bool dontOverrideCursor = adapter->getProperty(kDontOverrideCursorVar, false).toBool();
+    const bool dontToggleMaximize = adapter->getProperty(kDontToggleMaximizeVar, false).toBool();
     switch (type) {
     case QEvent::MouseButtonPress: {
         if (button == Qt::LeftButton) {
-            g_qtHelper()->mutex.lock();
-            g_qtHelper()->data[windowId].leftButtonPressed = true;
-            g_qtHelper()->mutex.unlock();
+            data.leftButtonPressed = true;
             if (!windowFixedSize) {
-                const Qt::Edges edges = Utils::calculateWindowEdges(window, scenePos);
-                if (edges != Qt::Edges{}) {
-                    Utils::startSystemResize(window, edges, globalPos);
+                if (hitTest.zone == HitTestZone::ResizeBorder) {
+                    Utils::startSystemResize(window, hitTest.edges, globalPos);
                     event->accept();
                     return true;
                 }
@@ -209,45 +228,42 @@ bool FramelessHelperQt::eventFilter(QObject *object, QEvent *event)
     } break;
     case QEvent::MouseButtonRelease: {
         if (button == Qt::LeftButton) {
-            const QMutexLocker locker(&g_qtHelper()->mutex);
-            g_qtHelper()->data[windowId].leftButtonPressed = false;
+            data.leftButtonPressed = false;
         }
         if (button == Qt::RightButton) {
-            if (!ignoreThisEvent && insideTitleBar) {
-                data.params.showSystemMenu(scenePos);
+            if (insideTitleBar) {
+                adapter->showSystemMenu(scenePos);
                 event->accept();
                 return true;
             }
         }
     } break;
     case QEvent::MouseButtonDblClick: {
-        if (!dontToggleMaximize && (button == Qt::LeftButton) && !windowFixedSize && !ignoreThisEvent && insideTitleBar) {
+        if (!dontToggleMaximize && (button == Qt::LeftButton) && !windowFixedSize && insideTitleBar) {
             Qt::WindowState newWindowState = Qt::WindowNoState;
-            if (data.params.getWindowState() != Qt::WindowMaximized) {
+            if (adapter->getWindowState() != Qt::WindowMaximized) {
                 newWindowState = Qt::WindowMaximized;
             }
-            data.params.setWindowState(newWindowState);
+            adapter->setWindowState(newWindowState);
             event->accept();
             return true;
         }
     } break;
     case QEvent::MouseMove: {
         if (!dontOverrideCursor && !windowFixedSize) {
-            const Qt::CursorShape cs = Utils::calculateCursorShape(window, scenePos);
+            const Qt::CursorShape cs = Utils::calculateCursorShape(hitTest.edges);
             if (cs == Qt::ArrowCursor) {
                 if (data.cursorShapeChanged) {
-                    data.params.unsetCursor();
-                    const QMutexLocker locker(&g_qtHelper()->mutex);
-                    g_qtHelper()->data[windowId].cursorShapeChanged = false;
+                    adapter->unsetCursor();
+                    data.cursorShapeChanged = false;
                 }
             } else {
-                data.params.setCursor(cs);
-                const QMutexLocker locker(&g_qtHelper()->mutex);
-                g_qtHelper()->data[windowId].cursorShapeChanged = true;
+                adapter->setCursor(cs);
+                data.cursorShapeChanged = true;
             }
         }
         if (data.leftButtonPressed) {
-            if (!ignoreThisEvent && insideTitleBar) {
+            if (insideTitleBar) {
                 Utils::startSystemMove(window, globalPos);
                 event->accept();
                 return true;
@@ -45,6 +45,8 @@
 #include <QtCore/qmutex.h>
 #include <QtCore/qiodevice.h>
 #include <QtCore/qcoreapplication.h>
+#include <QtCore/qvariant.h>
+#include <QtGui/qcursor.h>
 
 #ifndef COMPILER_STRING
 #  ifdef Q_CC_CLANG // Must be before GNU, because Clang claims to be GNU too.
@@ -134,6 +136,111 @@ using namespace Global;
 static_assert(std::size(WindowsVersions) == (static_cast<int>(WindowsVersion::Latest) + 1));
 #endif
 
+class SystemParametersAdapter final : public WindowAdapter
+{
+    Q_DISABLE_COPY_MOVE(SystemParametersAdapter)
+
+public:
+    explicit SystemParametersAdapter(const SystemParameters &params) : m_params(params) {}
+    ~SystemParametersAdapter() override = default;
+
+    Q_NODISCARD Qt::WindowFlags getWindowFlags() const override { return m_params.getWindowFlags(); }
+    void setWindowFlags(const Qt::WindowFlags flags) override { m_params.setWindowFlags(flags); }
+    Q_NODISCARD QSize getWindowSize() const override { return m_params.getWindowSize(); }
+    void setWindowSize(const QSize &size) override { m_params.setWindowSize(size); }
+    Q_NODISCARD QPoint getWindowPosition() const override { return m_params.getWindowPosition(); }
+    void setWindowPosition(const QPoint &pos) override { m_params.setWindowPosition(pos); }
+    Q_NODISCARD QScreen *getWindowScreen() const override { return m_params.getWindowScreen(); }
+    Q_NODISCARD bool isWindowFixedSize() const override { return m_params.isWindowFixedSize(); }
+    void setWindowFixedSize(const bool value) override { m_params.setWindowFixedSize(value); }
+    Q_NODISCARD Qt::WindowState getWindowState() const override { return m_params.getWindowState(); }
+    void setWindowState(const Qt::WindowState state) override { m_params.setWindowState(state); }
+    Q_NODISCARD QWindow *getWindowHandle() const override { return m_params.getWindowHandle(); }
+    Q_NODISCARD QPoint windowToScreen(const QPoint &pos) const override { return m_params.windowToScreen(pos); }
+    Q_NODISCARD QPoint screenToWindow(const QPoint &pos) const override { return m_params.screenToWindow(pos); }
+    Q_NODISCARD bool isInsideSystemButtons(const QPoint &pos, SystemButtonType *button) const override { return m_params.isInsideSystemButtons(pos, button); }
+    Q_NODISCARD bool isInsideTitleBarDraggableArea(const QPoint &pos) const override { return m_params.isInsideTitleBarDraggableArea(pos); }
+    Q_NODISCARD qreal getWindowDevicePixelRatio() const override { return m_params.getWindowDevicePixelRatio(); }
+    void setSystemButtonState(const SystemButtonType button, const ButtonState state) override { m_params.setSystemButtonState(button, state); }
+    Q_NODISCARD WId getWindowId() const override { return m_params.getWindowId(); }
+    Q_NODISCARD bool shouldIgnoreMouseEvents(const QPoint &pos) const override { return m_params.shouldIgnoreMouseEvents(pos); }
+    void showSystemMenu(const QPoint &pos) override { m_params.showSystemMenu(pos); }
+    void setProperty(const QByteArray &name, const QVariant &value) override { m_params.setProperty(name, value); }
+    Q_NODISCARD QVariant getProperty(const QByteArray &name, const QVariant &defaultValue) const override { return m_params.getProperty(name, defaultValue); }
+    void setCursor(const QCursor &cursor) override { m_params.setCursor(cursor); }
+    void unsetCursor() override { m_params.unsetCursor(); }
+    Q_NODISCARD QObject *getWidgetHandle() const override { return m_params.getWidgetHandle(); }
+
+private:
+    SystemParameters m_params = {};
+};
+
+Global::WindowAdapter::~WindowAdapter() = default;
+
+SystemParameters Global::WindowAdapter::toSystemParameters()
+{
+    SystemParameters params = {};
+    params.getWindowFlags = [this]() -> Qt::WindowFlags { return getWindowFlags(); };
+    params.setWindowFlags = [this](const Qt::WindowFlags flags) -> void { setWindowFlags(flags); };
+    params.getWindowSize = [this]() -> QSize { return getWindowSize(); };
+    params.setWindowSize = [this](const QSize &size) -> void { setWindowSize(size); };
+    params.getWindowPosition = [this]() -> QPoint { return getWindowPosition(); };
+    params.setWindowPosition = [this](const QPoint &pos) -> void { setWindowPosition(pos); };
+    params.getWindowScreen = [this]() -> QScreen * { return getWindowScreen(); };
+    params.isWindowFixedSize = [this]() -> bool { return isWindowFixedSize(); };
+    params.setWindowFixedSize = [this](const bool value) -> void { setWindowFixedSize(value); };
+    params.getWindowState = [this]() -> Qt::WindowState { return getWindowState(); };
+    params.setWindowState = [this](const Qt::WindowState state) -> void { setWindowState(state); };
+    params.getWindowHandle = [this]() -> QWindow * { return getWindowHandle(); };
+    params.windowToScreen = [this](const QPoint &pos) -> QPoint { return windowToScreen(pos); };
+    params.screenToWindow = [this](const QPoint &pos) -> QPoint { return screenToWindow(pos); };
+    params.isInsideSystemButtons = [this](const QPoint &pos, SystemButtonType *button) -> bool { return isInsideSystemButtons(pos, button); };
+    params.isInsideTitleBarDraggableArea = [this](const QPoint &pos) -> bool { return isInsideTitleBarDraggableArea(pos); };
+    params.getWindowDevicePixelRatio = [this]() -> qreal { return getWindowDevicePixelRatio(); };
+    params.setSystemButtonState = [this](const SystemButtonType button, const ButtonState state) -> void { setSystemButtonState(button, state); };
+    params.getWindowId = [this]() -> WId { return getWindowId(); };
+    params.shouldIgnoreMouseEvents = [this](const QPoint &pos) -> bool { return shouldIgnoreMouseEvents(pos); };
+    params.showSystemMenu = [this](const QPoint &pos) -> void { showSystemMenu(pos); };
+    params.setProperty = [this](const QByteArray &name, const QVariant &value) -> void { setProperty(name, value); };
+    params.getProperty = [this](const QByteArray &name, const QVariant &defaultValue) -> QVariant { return getProperty(name, defaultValue); };
+    params.setCursor = [this](const QCursor &cursor) -> void { setCursor(cursor); };
+    params.unsetCursor = [this]() -> void { unsetCursor(); };
+    params.getWidgetHandle = [this]() -> QObject * { return getWidgetHandle(); };
+    return params;
+}
+
+HitTestResult Global::WindowAdapter::classify(const QPoint &pos) const
+{
+    // We don't know anything about the title bar here, so the window border is the
+    // only thing we can classify ourself, everything else has to be asked for.
+    HitTestGeometry geometry = {};
+    geometry.windowSize = getWindowSize();
+    HitTestResult result = Utils::classifyHitTestZone(geometry, pos, (getWindowState() == Qt::WindowNoState));
+    if (result.zone != HitTestZone::Client) {
+        return result;
+    }
+    if (shouldIgnoreMouseEvents(pos)) {
+        return result;
+    }
+    SystemButtonType button = SystemButtonType::Unknown;
+    if (isInsideSystemButtons(pos, &button)) {
+        result.zone = HitTestZone::SystemButton;
+        result.button = button;
+    } else if (isInsideTitleBarDraggableArea(pos)) {
+        result.zone = HitTestZone::Caption;
+    }
+    return result;
+}
+
+std::unique_ptr<WindowAdapter> Global::WindowAdapter::fromSystemParameters(const SystemParameters &params)
+{
+    Q_ASSERT(params.isValid());
+    if (!params.isValid()) {
+        return nullptr;
+    }
+    return std::make_unique<SystemParametersAdapter>(params);
+}
+
 #ifdef Q_OS_LINUX
 [[maybe_unused]] static constexpr const char QT_QPA_ENV_VAR[] = "QT_QPA_PLATFORM";
 FRAMELESSHELPER_BYTEARRAY_CONSTANT(xcb)
@@ -174,7 +281,10 @@ void initialize()
     // enough, that is, before the construction of any Q(Gui)Application
     // instances. QCoreApplication won't instantiate the platform plugin.
     qputenv(QT_QPA_ENV_VAR, kxcb);
-    gtk_init(nullptr, nullptr);
+    // Don't even load GTK if the theme should come from the XDG desktop portal.
+    if (Utils::isGtkThemeBackendEnabled()) {
+        gtk_init(nullptr, nullptr);
+    }
 #endif
 
 #if (defined(Q_OS_MACOS) && (QT_VERSION < QT_VERSION_CHECK(6, 0, 0)))
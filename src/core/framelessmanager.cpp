@@ -26,18 +26,30 @@
 #include "framelessmanager_p.h"
 #include <QtCore/qmutex.h>
 #include <QtCore/qcoreapplication.h>
+#ifdef Q_OS_LINUX
+#  include <QtCore/qdatetime.h>
+#  include <QtCore/qfileinfo.h>
+#  include <QtCore/qfilesystemwatcher.h>
+#  include <QtCore/qstandardpaths.h>
+#endif
 #include <QtGui/qfontdatabase.h>
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 5, 0))
 #  include <QtGui/qguiapplication.h>
 #  include <QtGui/qstylehints.h>
 #endif // (QT_VERSION >= QT_VERSION_CHECK(6, 5, 0))
 #include "framelesshelper_qt.h"
+#include "micamaterial_p.h"
 #include "framelessconfig_p.h"
 #include "utils.h"
 #ifdef Q_OS_WINDOWS
 #  include "framelesshelper_win.h"
 #  include "winverhelper_p.h"
 #endif
+#ifdef FRAMELESSHELPER_CORE_HAS_DBUS
+#  include <QtDBus/qdbusconnection.h>
+#  include <QtDBus/qdbuserror.h>
+#endif
+
 
 #ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 // The "Q_INIT_RESOURCE()" macro can't be used within a namespace,
@@ -76,6 +88,54 @@ struct FramelessManagerHelper
 
 Q_GLOBAL_STATIC(FramelessManagerHelper, g_helper)
 
+#ifdef Q_OS_LINUX
+struct DesktopThemeCache
+{
+    QMutex mutex;
+    bool watched = false;
+    bool valid = false;
+    // Bumped whenever the cached values become outdated.
+    quint64 generation = 0;
+    bool preferDark = false;
+    QColor accentColor = {};
+};
+
+Q_GLOBAL_STATIC(DesktopThemeCache, g_desktopThemeCache)
+
+struct DesktopTheme
+{
+    bool preferDark = false;
+    QColor accentColor = {};
+};
+
+[[nodiscard]] static inline DesktopTheme desktopTheme()
+{
+    DesktopThemeCache * const cache = g_desktopThemeCache();
+    quint64 generation = 0;
+    {
+        const QMutexLocker locker(&cache->mutex);
+        if (cache->valid) {
+            return {cache->preferDark, cache->accentColor};
+        }
+        generation = cache->generation;
+    }
+    // Asking the portal is a blocking D-Bus call, other threads that only want
+    // the cached values must not have to wait for it.
+    DesktopTheme theme = {};
+    theme.preferDark = Utils::queryDarkThemePreference();
+    theme.accentColor = Utils::queryAccentColor();
+    const QMutexLocker locker(&cache->mutex);
+    // Without notifications we can't know when the values become outdated, and
+    // if they have changed while we were asking, what we got may be outdated already.
+    if (cache->watched && (cache->generation == generation)) {
+        cache->preferDark = theme.preferDark;
+        cache->accentColor = theme.accentColor;
+        cache->valid = true;
+    }
+    return theme;
+}
+#endif // Q_OS_LINUX
+
 Q_GLOBAL_STATIC(FramelessManager, g_manager)
 
 [[maybe_unused]] static constexpr const char kGlobalFlagVarName[] = "__FRAMELESSHELPER__";
@@ -205,13 +265,9 @@ void FramelessManagerPrivate::addWindow(const SystemParameters &params)
         return;
     }
     const WId windowId = params.getWindowId();
-    g_helper()->mutex.lock();
-    if (g_helper()->windowIds.contains(windowId)) {
-        g_helper()->mutex.unlock();
+    if (!registerWindowId(windowId)) {
         return;
     }
-    g_helper()->windowIds.append(windowId);
-    g_helper()->mutex.unlock();
     static const bool pureQt = usePureQtImplementation();
     if (pureQt) {
         FramelessHelperQt::addWindow(params);
@@ -225,6 +281,45 @@ void FramelessManagerPrivate::addWindow(const SystemParameters &params)
 #endif
 }
 
+void FramelessManagerPrivate::addWindow(WindowAdapter *adapter)
+{
+    Q_ASSERT(adapter);
+    if (!adapter) {
+        return;
+    }
+    const WId windowId = adapter->getWindowId();
+    if (!registerWindowId(windowId)) {
+        return;
+    }
+    static const bool pureQt = usePureQtImplementation();
+    if (pureQt) {
+        FramelessHelperQt::addWindow(adapter);
+    }
+#ifdef Q_OS_WINDOWS
+    // The Win32 implementation still works with the std::function based interface.
+    const SystemParameters params = adapter->toSystemParameters();
+    if (!pureQt) {
+        FramelessHelperWin::addWindow(params);
+    }
+    Utils::installSystemMenuHook(windowId, params.isWindowFixedSize,
+        params.isInsideTitleBarDraggableArea, params.getWindowHandle);
+#endif
+}
+
+bool FramelessManagerPrivate::registerWindowId(const WId windowId)
+{
+    Q_ASSERT(windowId);
+    if (!windowId) {
+        return false;
+    }
+    const QMutexLocker locker(&g_helper()->mutex);
+    if (g_helper()->windowIds.contains(windowId)) {
+        return false;
+    }
+    g_helper()->windowIds.append(windowId);
+    return true;
+}
+
 void FramelessManagerPrivate::removeWindow(const WId windowId)
 {
     Q_ASSERT(windowId);
@@ -313,6 +408,150 @@ void FramelessManagerPrivate::notifyWallpaperHasChangedOrNot()
     }
 }
 
+#ifdef Q_OS_LINUX
+void FramelessManagerPrivate::notifyDesktopThemeHasChanged()
+{
+    invalidateDesktopThemeCache();
+    notifySystemThemeHasChangedOrNot();
+}
+
+bool FramelessManagerPrivate::desktopPrefersDarkTheme()
+{
+    return desktopTheme().preferDark;
+}
+
+QColor FramelessManagerPrivate::desktopAccentColor()
+{
+    return desktopTheme().accentColor;
+}
+
+void FramelessManagerPrivate::setDesktopThemeWatched(const bool value)
+{
+    const QMutexLocker locker(&g_desktopThemeCache()->mutex);
+    g_desktopThemeCache()->watched = value;
+    g_desktopThemeCache()->valid = false;
+    ++g_desktopThemeCache()->generation;
+}
+
+void FramelessManagerPrivate::invalidateDesktopThemeCache()
+{
+    const QMutexLocker locker(&g_desktopThemeCache()->mutex);
+    g_desktopThemeCache()->valid = false;
+    ++g_desktopThemeCache()->generation;
+}
+
+bool FramelessManagerPrivate::watchXdgDesktopPortal()
+{
+#ifdef FRAMELESSHELPER_CORE_HAS_DBUS
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.isConnected()) {
+        WARNING << "Can't connect to the D-Bus session bus, system theme changes won't be noticed.";
+        return false;
+    }
+    // Only the appearance namespace is interesting, let the bus filter out the rest.
+    const bool connected = bus.connect(QUtf8String(XDG_PORTAL_SERVICE), QUtf8String(XDG_PORTAL_PATH),
+        QUtf8String(XDG_PORTAL_SETTINGS_INTERFACE), QUtf8String(XDG_PORTAL_SETTING_CHANGED_SIGNAL),
+        QStringList{ QUtf8String(XDG_APPEARANCE_NAMESPACE) }, QString{},
+        this, SLOT(notifyDesktopThemeHasChanged()));
+    if (!connected) {
+        WARNING << "Failed to subscribe to the setting changes of the XDG desktop portal:" << bus.lastError();
+        return false;
+    }
+#endif // FRAMELESSHELPER_CORE_HAS_DBUS
+    // Without QtDBus the portal is never asked, so there's nothing to watch.
+    return true;
+}
+
+// Which file is in use and when it was last changed, enough to tell whether
+// a change in one of the watched directories has anything to do with it.
+[[nodiscard]] static inline QString gtkSettingsIniSignature(const QString &filePath)
+{
+    if (filePath.isEmpty()) {
+        return {};
+    }
+    const QFileInfo fileInfo(filePath);
+    return (filePath + u'|' + QString::number(fileInfo.lastModified().toMSecsSinceEpoch())
+        + u'|' + QString::number(fileInfo.size()));
+}
+
+bool FramelessManagerPrivate::watchGtkSettingsIni()
+{
+    if (!m_gtkSettingsIniWatcher) {
+        m_gtkSettingsIniWatcher = new QFileSystemWatcher(this);
+        connect(m_gtkSettingsIniWatcher, &QFileSystemWatcher::fileChanged,
+            this, &FramelessManagerPrivate::handleGtkSettingsIniChanged);
+        connect(m_gtkSettingsIniWatcher, &QFileSystemWatcher::directoryChanged,
+            this, &FramelessManagerPrivate::handleGtkConfigDirectoryChanged);
+    }
+    const QStringList oldPaths = (m_gtkSettingsIniWatcher->files() + m_gtkSettingsIniWatcher->directories());
+    if (!oldPaths.isEmpty()) {
+        m_gtkSettingsIniWatcher->removePaths(oldPaths);
+    }
+    QStringList paths = {};
+    // The same file Utils::queryDarkThemePreference() falls back to.
+    const QString filePath = QStandardPaths::locate(QStandardPaths::GenericConfigLocation, QUtf8String(GTK_SETTINGS_INI_FILE));
+    if (!filePath.isEmpty()) {
+        paths.append(filePath);
+    }
+    m_gtkSettingsIniSignature = gtkSettingsIniSignature(filePath);
+    // Most editors replace the file instead of writing into it, and a file created in the
+    // user's config directory takes precedence over the system wide ones, so that
+    // directory (or its parent, as long as it doesn't exist) is watched as well. Only
+    // changes of the file itself count, see handleGtkConfigDirectoryChanged().
+    const QString configDirPath = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation);
+    const QString userDirPath = QFileInfo(configDirPath + u'/' + QUtf8String(GTK_SETTINGS_INI_FILE)).absolutePath();
+    if (QFileInfo::exists(userDirPath)) {
+        paths.append(userDirPath);
+    } else if (QFileInfo::exists(configDirPath)) {
+        paths.append(configDirPath);
+    }
+    if (paths.isEmpty()) {
+        return false;
+    }
+    const QStringList failedPaths = m_gtkSettingsIniWatcher->addPaths(paths);
+    if (!failedPaths.isEmpty()) {
+        WARNING << "Failed to watch" << failedPaths << ", GTK settings changes won't be noticed.";
+        return false;
+    }
+    return true;
+}
+
+void FramelessManagerPrivate::handleGtkSettingsIniChanged()
+{
+    // The file may have been replaced, removed or shadowed by a new one, which
+    // drops it from the watcher, so start over with the file that is in use now.
+    if (!watchGtkSettingsIni()) {
+        setDesktopThemeWatched(false);
+    }
+    notifyDesktopThemeHasChanged();
+}
+
+void FramelessManagerPrivate::handleGtkConfigDirectoryChanged()
+{
+    // Without "gtk-3.0" the whole config directory is watched, which changes all the
+    // time. Re-reading the theme means two blocking calls to the portal, so only do
+    // that if it's the file in use that has changed. Watching again also moves on to
+    // "gtk-3.0" once it has been created.
+    const QString oldSignature = m_gtkSettingsIniSignature;
+    if (!watchGtkSettingsIni()) {
+        setDesktopThemeWatched(false);
+    }
+    if (m_gtkSettingsIniSignature == oldSignature) {
+        return;
+    }
+    notifyDesktopThemeHasChanged();
+}
+#endif // Q_OS_LINUX
+
+void FramelessManagerPrivate::notifyWindowManagerHasChanged()
+{
+    Q_Q(FramelessManager);
+    Q_EMIT q->windowManagerChanged();
+#ifdef Q_OS_LINUX
+    DEBUG << "Window manager changed. Current window manager:" << Utils::getWindowManagerName();
+#endif
+}
+
 bool FramelessManagerPrivate::usePureQtImplementation()
 {
     static const auto result = []() -> bool {
@@ -328,6 +567,16 @@ bool FramelessManagerPrivate::usePureQtImplementation()
 void FramelessManagerPrivate::initialize()
 {
     const QMutexLocker locker(&g_helper()->mutex);
+#ifdef Q_OS_LINUX
+    // When GTK is used, Utils::registerThemeChangeNotification() subscribes to its own
+    // notifications. Otherwise the settings come from the portal, falling back to GTK's
+    // settings.ini, and the cached values can only be trusted if both of them are watched.
+    if (!Utils::isGtkThemeBackendEnabled()) {
+        const bool portalWatched = watchXdgDesktopPortal();
+        const bool settingsIniWatched = watchGtkSettingsIni();
+        setDesktopThemeWatched(portalWatched && settingsIniWatched);
+    }
+#endif
     m_systemTheme = Utils::getSystemTheme();
 #ifdef Q_OS_WINDOWS
     m_colorizationArea = Utils::getDwmColorizationArea();
@@ -341,6 +590,9 @@ void FramelessManagerPrivate::initialize()
 #endif
     m_wallpaper = Utils::getWallpaperFilePath();
     m_wallpaperAspectStyle = Utils::getWallpaperAspectStyle();
+#ifdef Q_OS_LINUX
+    Utils::registerWindowManagerChangeNotification();
+#endif
     DEBUG.nospace() << "Current system theme: " << m_systemTheme
                     << ", accent color: " << m_accentColor.name(QColor::HexArgb).toUpper()
 #ifdef Q_OS_WINDOWS
@@ -412,10 +664,21 @@ void FramelessManager::addWindow(const SystemParameters &params)
     d->addWindow(params);
 }
 
+void FramelessManager::addWindow(WindowAdapter *adapter)
+{
+    Q_D(FramelessManager);
+    d->addWindow(adapter);
+}
+
 void FramelessManager::removeWindow(const WId windowId)
 {
     Q_D(FramelessManager);
     d->removeWindow(windowId);
 }
 
+void FramelessManager::trimCaches(const CacheTrimLevel level)
+{
+    MicaMaterialPrivate::trimCaches(level);
+}
+
 FRAMELESSHELPER_END_NAMESPACE
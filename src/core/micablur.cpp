@@ -0,0 +1,1015 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "micablur_p.h"
+#include <QtCore/qsysinfo.h>
+#include <QtCore/qmath.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qrunnable.h>
+#include <QtCore/qsemaphore.h>
+#include <QtCore/qvarlengtharray.h>
+#include <QtGui/qpainter.h>
+#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+#  include <QtCore/private/qsimd_p.h>
+#  include <QtGui/private/qmemrotate_p.h>
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+#include <atomic>
+#include <functional>
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+using namespace Global;
+
+// The vectorized row kernels need the CPU feature detection of QtCore.
+#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+#  ifdef __SSE2__
+#    define FRAMELESSHELPER_HAS_BLUR_SSE2
+#  endif
+#  if defined(QT_COMPILER_SUPPORTS_AVX2) && defined(FRAMELESSHELPER_HAS_BLUR_SSE2)
+#    define FRAMELESSHELPER_HAS_BLUR_AVX2
+#  endif
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+
+// A dedicated pool, so that blurring never competes with the application's own work
+// in QThreadPool::globalInstance(), and so that its size can be tuned separately.
+Q_GLOBAL_STATIC(QThreadPool, g_micaBlurThreadPool)
+
+static std::atomic<MicaBlur::RowKernel> g_rowKernel{MicaBlur::RowKernel::Auto};
+
+class BlurTask : public QRunnable
+{
+public:
+    explicit BlurTask(std::function<void()> function) : m_function(std::move(function)) {}
+    ~BlurTask() override = default;
+
+    void run() override
+    {
+        m_function();
+    }
+
+private:
+    std::function<void()> m_function = nullptr;
+};
+
+// Calls "function(begin, end)" for consecutive chunks of [0, count), spread across the blur
+// thread pool. The calling thread takes part as well, and the helpers are only started if
+// there are idle threads, so this is safe to call from a pool thread, too.
+template<typename Function>
+static inline void qt_blurParallelFor(const int count, const int granularity, const Function &function)
+{
+    Q_ASSERT(granularity > 0);
+    QThreadPool * const pool = g_micaBlurThreadPool();
+    const int threadCount = qMin(pool->maxThreadCount(), ((count + granularity - 1) / granularity));
+    if (threadCount <= 1) {
+        function(0, count);
+        return;
+    }
+    std::atomic_int next(0);
+    const auto worker = [&next, count, granularity, &function]() -> void {
+        for (int begin = next.fetch_add(granularity); begin < count; begin = next.fetch_add(granularity)) {
+            function(begin, qMin(begin + granularity, count));
+        }
+    };
+    QSemaphore finished;
+    int started = 0;
+    for (int i = 1; i != threadCount; ++i) {
+        if (!pool->tryStart(new BlurTask([&worker, &finished]() -> void {
+                worker();
+                finished.release();
+            }))) {
+            break;
+        }
+        ++started;
+    }
+    worker();
+    finished.acquire(started);
+}
+
+#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
+[[nodiscard]] static inline MicaBlur::RowKernel currentRowKernel()
+{
+    const MicaBlur::RowKernel kernel = g_rowKernel.load(std::memory_order_relaxed);
+    if (kernel != MicaBlur::RowKernel::Auto) {
+        return kernel;
+    }
+#ifdef FRAMELESSHELPER_HAS_BLUR_AVX2
+    if (qCpuHasFeature(AVX2)) {
+        return MicaBlur::RowKernel::AVX2;
+    }
+#endif // FRAMELESSHELPER_HAS_BLUR_AVX2
+#ifdef FRAMELESSHELPER_HAS_BLUR_SSE2
+    return MicaBlur::RowKernel::SSE2;
+#else // !FRAMELESSHELPER_HAS_BLUR_SSE2
+    return MicaBlur::RowKernel::Scalar;
+#endif // FRAMELESSHELPER_HAS_BLUR_SSE2
+}
+
+template<const int shift>
+[[nodiscard]] static inline constexpr int qt_static_shift(const int value)
+{
+    if constexpr (shift == 0) {
+        return value;
+    } else if constexpr (shift > 0) {
+        return (value << (quint32(shift) & 0x1f));
+    } else {
+        return (value >> (quint32(-shift) & 0x1f));
+    }
+}
+
+template<const int aprec, const int zprec>
+static inline void qt_blurinner(uchar *bptr, int &zR, int &zG, int &zB, int &zA, const int alpha)
+{
+    const auto pixel = reinterpret_cast<QRgb *>(bptr);
+
+#define Z_MASK (0xff << zprec)
+    const int A_zprec = (qt_static_shift<zprec - 24>(*pixel) & Z_MASK);
+    const int R_zprec = (qt_static_shift<zprec - 16>(*pixel) & Z_MASK);
+    const int G_zprec = (qt_static_shift<zprec - 8>(*pixel)  & Z_MASK);
+    const int B_zprec = (qt_static_shift<zprec>(*pixel)      & Z_MASK);
+#undef Z_MASK
+
+    const int zR_zprec = (zR >> aprec);
+    const int zG_zprec = (zG >> aprec);
+    const int zB_zprec = (zB >> aprec);
+    const int zA_zprec = (zA >> aprec);
+
+    zR += (alpha * (R_zprec - zR_zprec));
+    zG += (alpha * (G_zprec - zG_zprec));
+    zB += (alpha * (B_zprec - zB_zprec));
+    zA += (alpha * (A_zprec - zA_zprec));
+
+#define ZA_MASK (0xff << (zprec + aprec))
+    *pixel = (qt_static_shift<24 - zprec - aprec>(zA & ZA_MASK)
+        | qt_static_shift<16 - zprec - aprec>(zR & ZA_MASK)
+        | qt_static_shift<8 - zprec - aprec>(zG & ZA_MASK)
+        | qt_static_shift<-zprec - aprec>(zB & ZA_MASK));
+#undef ZA_MASK
+}
+
+static constexpr const int alphaIndex = ((QSysInfo::ByteOrder == QSysInfo::BigEndian) ? 0 : 3);
+
+// The pixels of an image for the blur kernels. The non-const QImage accessors may detach
+// the image, which must never happen on the blur threads, so the image is detached once
+// on the calling thread and the kernels only get its raw memory.
+class BlurImageData
+{
+public:
+    explicit BlurImageData(QImage &image)
+        : m_bits(image.bits()), m_bytesPerLine(image.bytesPerLine()), m_width(image.width()),
+          m_height(image.height()), m_depth(image.depth()), m_format(image.format()) {}
+
+    [[nodiscard]] uchar *bits() const { return m_bits; }
+    [[nodiscard]] uchar *scanLine(const int line) const { return (m_bits + (qsizetype(line) * m_bytesPerLine)); }
+    [[nodiscard]] qsizetype bytesPerLine() const { return m_bytesPerLine; }
+    [[nodiscard]] int width() const { return m_width; }
+    [[nodiscard]] int height() const { return m_height; }
+    [[nodiscard]] int depth() const { return m_depth; }
+    [[nodiscard]] QImage::Format format() const { return m_format; }
+
+private:
+    uchar *m_bits = nullptr;
+    qsizetype m_bytesPerLine = 0;
+    int m_width = 0;
+    int m_height = 0;
+    int m_depth = 0;
+    QImage::Format m_format = QImage::Format_Invalid;
+};
+
+template<const int aprec, const int zprec>
+static inline void qt_blurinner_alphaOnly(uchar *bptr, int &z, const int alpha)
+{
+    const int A_zprec = (int(*(bptr)) << zprec);
+    const int z_zprec = (z >> aprec);
+    z += (alpha * (A_zprec - z_zprec));
+    *(bptr) = (z >> (zprec + aprec));
+}
+
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void qt_blurrow(const BlurImageData &im, const int line, const int alpha)
+{
+    uchar *bptr = im.scanLine(line);
+
+    int zR = 0, zG = 0, zB = 0, zA = 0;
+
+#ifdef Q_CC_MSVC
+#  pragma warning(push)
+#  pragma warning(disable:4127) // false alarm.
+#endif // Q_CC_MSVC
+    if (alphaOnly && (im.format() != QImage::Format_Indexed8)) {
+        bptr += alphaIndex;
+    }
+#ifdef Q_CC_MSVC
+#  pragma warning(pop)
+#endif // Q_CC_MSVC
+
+    const int stride = (im.depth() >> 3);
+    const int im_width = im.width();
+    for (int index = 0; index != im_width; ++index) {
+        if (alphaOnly) {
+            qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA, alpha);
+        } else {
+            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
+        }
+        bptr += stride;
+    }
+
+    bptr -= stride;
+
+    for (int index = (im_width - 2); index >= 0; --index) {
+        bptr -= stride;
+        if (alphaOnly) {
+            qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA, alpha);
+        } else {
+            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
+        }
+    }
+}
+
+// Vectorized versions of qt_blurrow(), for 32-bit images only. All four channels of a pixel
+// are kept in one register, the arithmetic is exactly the same as qt_blurinner(), so the
+// results are bit-exact to the scalar code, which is still used everywhere else.
+#ifdef FRAMELESSHELPER_HAS_BLUR_SSE2
+// SSE2 has no _mm_mullo_epi32(), but the lower 32 bits of the product are the same
+// for signed and unsigned numbers, so two _mm_mul_epu32() will do.
+[[nodiscard]] static inline __m128i qt_mullo_epi32_sse2(const __m128i a, const __m128i b)
+{
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+template<const int aprec, const int zprec>
+static inline void qt_blurinner_sse2(quint32 *pixel, __m128i &z, const __m128i alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(*pixel)), zero), zero);
+    const __m128i diff = _mm_sub_epi32(_mm_slli_epi32(p, zprec), _mm_srai_epi32(z, aprec));
+    z = _mm_add_epi32(z, qt_mullo_epi32_sse2(diff, alpha));
+    __m128i result = _mm_and_si128(_mm_srai_epi32(z, zprec + aprec), _mm_set1_epi32(0xff));
+    result = _mm_packs_epi32(result, result);
+    result = _mm_packus_epi16(result, result);
+    *pixel = quint32(_mm_cvtsi128_si32(result));
+}
+
+// The blur of a single row is one long dependency chain, so we walk several rows at
+// the same time to give the CPU something to do while it waits for the previous pixel.
+template<const int aprec, const int zprec, const int rows>
+static inline void qt_blurrows_sse2(const BlurImageData &im, const int line, const int alpha)
+{
+    quint32 *pixels[rows] = {};
+    __m128i z[rows] = {};
+    for (int row = 0; row != rows; ++row) {
+        pixels[row] = reinterpret_cast<quint32 *>(im.scanLine(line + row));
+        z[row] = _mm_setzero_si128();
+    }
+    const __m128i valpha = _mm_set1_epi32(alpha);
+    const int im_width = im.width();
+    for (int index = 0; index != im_width; ++index) {
+        for (int row = 0; row != rows; ++row) {
+            qt_blurinner_sse2<aprec, zprec>(pixels[row] + index, z[row], valpha);
+        }
+    }
+    for (int index = (im_width - 2); index >= 0; --index) {
+        for (int row = 0; row != rows; ++row) {
+            qt_blurinner_sse2<aprec, zprec>(pixels[row] + index, z[row], valpha);
+        }
+    }
+}
+#endif // FRAMELESSHELPER_HAS_BLUR_SSE2
+
+#ifdef FRAMELESSHELPER_HAS_BLUR_AVX2
+// Two rows per register: the lower 128 bits belong to the first row, the upper ones to the second.
+template<const int aprec, const int zprec>
+static inline void QT_FUNCTION_TARGET(AVX2) qt_blurinner_avx2(quint32 *pixel1, quint32 *pixel2, __m256i &z, const __m256i alpha)
+{
+    const __m256i p = _mm256_cvtepu8_epi32(_mm_set_epi32(0, 0, int(*pixel2), int(*pixel1)));
+    const __m256i diff = _mm256_sub_epi32(_mm256_slli_epi32(p, zprec), _mm256_srai_epi32(z, aprec));
+    z = _mm256_add_epi32(z, _mm256_mullo_epi32(diff, alpha));
+    __m256i result = _mm256_and_si256(_mm256_srai_epi32(z, zprec + aprec), _mm256_set1_epi32(0xff));
+    result = _mm256_packus_epi32(result, result);
+    result = _mm256_packus_epi16(result, result);
+    *pixel1 = quint32(_mm_cvtsi128_si32(_mm256_castsi256_si128(result)));
+    *pixel2 = quint32(_mm_cvtsi128_si32(_mm256_extracti128_si256(result, 1)));
+}
+
+template<const int aprec, const int zprec, const int rows>
+static inline void QT_FUNCTION_TARGET(AVX2) qt_blurrows_avx2(const BlurImageData &im, const int line, const int alpha)
+{
+    static_assert((rows % 2) == 0);
+    static constexpr const int chains = (rows / 2);
+    quint32 *pixels[rows] = {};
+    __m256i z[chains] = {};
+    for (int row = 0; row != rows; ++row) {
+        pixels[row] = reinterpret_cast<quint32 *>(im.scanLine(line + row));
+    }
+    for (int chain = 0; chain != chains; ++chain) {
+        z[chain] = _mm256_setzero_si256();
+    }
+    const __m256i valpha = _mm256_set1_epi32(alpha);
+    const int im_width = im.width();
+    for (int index = 0; index != im_width; ++index) {
+        for (int chain = 0; chain != chains; ++chain) {
+            qt_blurinner_avx2<aprec, zprec>(pixels[chain * 2] + index, pixels[(chain * 2) + 1] + index, z[chain], valpha);
+        }
+    }
+    for (int index = (im_width - 2); index >= 0; --index) {
+        for (int chain = 0; chain != chains; ++chain) {
+            qt_blurinner_avx2<aprec, zprec>(pixels[chain * 2] + index, pixels[(chain * 2) + 1] + index, z[chain], valpha);
+        }
+    }
+}
+#endif // FRAMELESSHELPER_HAS_BLUR_AVX2
+
+// Blurs the rows [firstRow, lastRow) of the image, "passes" times each, with the selected
+// row kernel.
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void qt_blurrows(const BlurImageData &im, const int firstRow, const int lastRow, const int alpha, const int passes)
+{
+    static constexpr const int kRowsPerBatch = 4;
+    int row = firstRow;
+    if constexpr (!alphaOnly) {
+        const MicaBlur::RowKernel kernel = ((im.depth() == 32) ? currentRowKernel() : MicaBlur::RowKernel::Scalar);
+        for (; (kernel != MicaBlur::RowKernel::Scalar) && ((row + kRowsPerBatch) <= lastRow); row += kRowsPerBatch) {
+            for (int i = 0; i != passes; ++i) {
+                switch (kernel) {
+#ifdef FRAMELESSHELPER_HAS_BLUR_AVX2
+                case MicaBlur::RowKernel::AVX2:
+                    qt_blurrows_avx2<aprec, zprec, kRowsPerBatch>(im, row, alpha);
+                    break;
+#endif // FRAMELESSHELPER_HAS_BLUR_AVX2
+#ifdef FRAMELESSHELPER_HAS_BLUR_SSE2
+                case MicaBlur::RowKernel::SSE2:
+                    qt_blurrows_sse2<aprec, zprec, kRowsPerBatch>(im, row, alpha);
+                    break;
+#endif // FRAMELESSHELPER_HAS_BLUR_SSE2
+                default:
+                    Q_UNREACHABLE();
+                    break;
+                }
+            }
+        }
+    }
+    for (; row < lastRow; ++row) {
+        for (int i = 0; i != passes; ++i) {
+            qt_blurrow<aprec, zprec, alphaOnly>(im, row, alpha);
+        }
+    }
+}
+
+// The rotations are split into vertical strips of the source image, which become whole
+// rows of the destination image, so every thread writes to its own part of the memory.
+template<typename T>
+static inline void qt_memrotate_parallel(const bool rotate270, const QImage &src, QImage &dest)
+{
+    const int w = src.width();
+    const int h = src.height();
+    const qsizetype sstride = src.bytesPerLine();
+    const qsizetype dstride = dest.bytesPerLine();
+    const auto srcBits = reinterpret_cast<const T *>(src.constBits());
+    const auto destBits = dest.bits();
+    static constexpr const int kColumnsPerStrip = 64;
+    qt_blurParallelFor(w, kColumnsPerStrip, [&](const int x0, const int x1) -> void {
+        if (rotate270) {
+            // qt_memrotate270(): dest[x][h - 1 - y] = src[y][x]
+            qt_memrotate270(srcBits + x0, (x1 - x0), h, sstride,
+                            reinterpret_cast<T *>(destBits + (x0 * dstride)), dstride);
+        } else {
+            // qt_memrotate90(): dest[w - 1 - x][y] = src[y][x]
+            qt_memrotate90(srcBits + x0, (x1 - x0), h, sstride,
+                           reinterpret_cast<T *>(destBits + ((w - x1) * dstride)), dstride);
+        }
+    });
+}
+
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void qt_blurrows_parallel(QImage &im, const int alpha, const int passes)
+{
+    static constexpr const int kRowsPerChunk = 32;
+    const BlurImageData data(im);
+    qt_blurParallelFor(data.height(), kRowsPerChunk, [&](const int firstRow, const int lastRow) -> void {
+        qt_blurrows<aprec, zprec, alphaOnly>(data, firstRow, lastRow, alpha, passes);
+    });
+}
+
+// The column pass of expblur() without transposing the image: the columns are blurred in
+// vertical strips that are narrow enough for all of their rows to stay in the cache, and
+// every column of a strip keeps its own accumulators. The columns are walked bottom to top
+// first, just like the rows of the image rotated by 270 degrees, so the result is bit-exact
+// to blurring the rotated image.
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void qt_blurcolumns(const BlurImageData &im, const int firstColumn, const int lastColumn, const int alpha, const int passes)
+{
+    static constexpr const int kMaxColumnsPerStrip = 64;
+    const int h = im.height();
+    const qsizetype bpl = im.bytesPerLine();
+    const int stride = (im.depth() >> 3);
+    // One cache line worth of pixels per row.
+    const int columnsPerStrip = ((stride == 1) ? kMaxColumnsPerStrip : 16);
+    uchar *bits = im.bits();
+#ifdef Q_CC_MSVC
+#  pragma warning(push)
+#  pragma warning(disable:4127) // false alarm.
+#endif // Q_CC_MSVC
+    if (alphaOnly && (im.format() != QImage::Format_Indexed8)) {
+        bits += alphaIndex;
+    }
+#ifdef Q_CC_MSVC
+#  pragma warning(pop)
+#endif // Q_CC_MSVC
+    int zR[kMaxColumnsPerStrip], zG[kMaxColumnsPerStrip], zB[kMaxColumnsPerStrip], zA[kMaxColumnsPerStrip];
+    for (int x0 = firstColumn; x0 < lastColumn; x0 += columnsPerStrip) {
+        const int count = qMin(columnsPerStrip, (lastColumn - x0));
+        const auto blurLine = [&](const int y) -> void {
+            uchar *bptr = (bits + (y * bpl) + (x0 * stride));
+            for (int i = 0; i != count; ++i, bptr += stride) {
+                if (alphaOnly) {
+                    qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA[i], alpha);
+                } else {
+                    qt_blurinner<aprec, zprec>(bptr, zR[i], zG[i], zB[i], zA[i], alpha);
+                }
+            }
+        };
+        for (int pass = 0; pass != passes; ++pass) {
+            for (int i = 0; i != count; ++i) {
+                zR[i] = zG[i] = zB[i] = zA[i] = 0;
+            }
+            for (int y = (h - 1); y >= 0; --y) {
+                blurLine(y);
+            }
+            for (int y = 1; y < h; ++y) {
+                blurLine(y);
+            }
+        }
+    }
+}
+
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void qt_blurcolumns_parallel(QImage &im, const int alpha, const int passes)
+{
+    static constexpr const int kColumnsPerChunk = 64;
+    const BlurImageData data(im);
+    qt_blurParallelFor(data.width(), kColumnsPerChunk, [&](const int firstColumn, const int lastColumn) -> void {
+        qt_blurcolumns<aprec, zprec, alphaOnly>(data, firstColumn, lastColumn, alpha, passes);
+    });
+}
+
+/*
+*  expblur(QImage &img, int radius)
+*
+*  Based on exponential blur algorithm by Jani Huhtanen
+*
+*  In-place blur of image 'img' with kernel
+*  of approximate radius 'radius'.
+*
+*  Blurs with two sided exponential impulse
+*  response.
+*
+*  aprec = precision of alpha parameter
+*  in fixed-point format 0.aprec
+*
+*  zprec = precision of state parameters
+*  zR,zG,zB and zA in fp format 8.zprec
+*/
+template<const int aprec, const int zprec, const bool alphaOnly>
+static inline void expblur(QImage &img, qreal radius, const bool improvedQuality = false, const int transposed = 0)
+{
+    Q_ASSERT((img.format() == QImage::Format_ARGB32_Premultiplied)
+             || (img.format() == QImage::Format_RGB32)
+             || (img.format() == QImage::Format_Indexed8)
+             || (img.format() == QImage::Format_Grayscale8));
+    if ((img.format() != QImage::Format_ARGB32_Premultiplied)
+        && (img.format() != QImage::Format_RGB32)
+        && (img.format() != QImage::Format_Indexed8)
+        && (img.format() != QImage::Format_Grayscale8)) {
+        return;
+    }
+
+    // halve the radius if we're using two passes
+    if (improvedQuality) {
+        radius *= 0.5;
+    }
+
+    // choose the alpha such that pixels at radius distance from a fully
+    // saturated pixel will have an alpha component of no greater than
+    // the cutOffIntensity
+    static constexpr const qreal cutOffIntensity = 2.0;
+    const int alpha = ((radius <= qreal(1e-5)) ? ((1 << aprec) - 1) :
+        std::round((1 << aprec) * (1 - qPow(cutOffIntensity / qreal(255), qreal(1) / radius))));
+
+    const int passes = (improvedQuality ? 2 : 1);
+    qt_blurrows_parallel<aprec, zprec, alphaOnly>(img, alpha, passes);
+
+    if (transposed == 0) {
+        // No need for a second image and two rotations if the result isn't transposed.
+        qt_blurcolumns_parallel<aprec, zprec, alphaOnly>(img, alpha, passes);
+        return;
+    }
+
+    QImage temp(img.height(), img.width(), img.format());
+    temp.setDevicePixelRatio(img.devicePixelRatio());
+
+    if (img.depth() == 8) {
+        qt_memrotate_parallel<quint8>((transposed >= 0), img, temp);
+    } else {
+        qt_memrotate_parallel<quint32>((transposed >= 0), img, temp);
+    }
+
+    qt_blurrows_parallel<aprec, zprec, alphaOnly>(temp, alpha, passes);
+
+    img = temp;
+}
+
+#define AVG(a,b)  ( ((((a)^(b)) & 0xfefefefeUL) >> 1) + ((a)&(b)) )
+#define AVG16(a,b)  ( ((((a)^(b)) & 0xf7deUL) >> 1) + ((a)&(b)) )
+
+[[nodiscard]] static inline QImage qt_halfScaled(const QImage &source)
+{
+    if ((source.width() < 2) || (source.height() < 2)) {
+        return {};
+    }
+
+    QImage srcImage = source;
+
+    if ((source.format() == QImage::Format_Indexed8)
+        || (source.format() == QImage::Format_Grayscale8)) {
+        // assumes grayscale
+        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
+        dest.setDevicePixelRatio(source.devicePixelRatio());
+
+        auto src = reinterpret_cast<const uchar *>(const_cast<const QImage &>(srcImage).bits());
+        const qsizetype sx = srcImage.bytesPerLine();
+        const qsizetype sx2 = (sx << 1);
+
+        auto dst = reinterpret_cast<uchar *>(dest.bits());
+        const qsizetype dx = dest.bytesPerLine();
+        const int ww = dest.width();
+        const int hh = dest.height();
+
+        for (int y = hh; y; --y, dst += dx, src += sx2) {
+            const uchar *p1 = src;
+            const uchar *p2 = (src + sx);
+            uchar *q = dst;
+            for (int x = ww; x; --x, ++q, p1 += 2, p2 += 2) {
+                *q = (((int(p1[0]) + int(p1[1]) + int(p2[0]) + int(p2[1])) + 2) >> 2);
+            }
+        }
+
+        return dest;
+    }
+    if (source.format() == QImage::Format_ARGB8565_Premultiplied) {
+        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
+        dest.setDevicePixelRatio(source.devicePixelRatio());
+
+        auto src = reinterpret_cast<const uchar *>(const_cast<const QImage &>(srcImage).bits());
+        const qsizetype sx = srcImage.bytesPerLine();
+        const qsizetype sx2 = (sx << 1);
+
+        auto dst = reinterpret_cast<uchar *>(dest.bits());
+        const qsizetype dx = dest.bytesPerLine();
+        const int ww = dest.width();
+        const int hh = dest.height();
+
+        for (int y = hh; y; --y, dst += dx, src += sx2) {
+            const uchar *p1 = src;
+            const uchar *p2 = (src + sx);
+            uchar *q = dst;
+            for (int x = ww; x; --x, q += 3, p1 += 6, p2 += 6) {
+                // alpha
+                q[0] = AVG(AVG(p1[0], p1[3]), AVG(p2[0], p2[3]));
+                // rgb
+                const quint16 p16_1 = ((p1[2] << 8) | p1[1]);
+                const quint16 p16_2 = ((p1[5] << 8) | p1[4]);
+                const quint16 p16_3 = ((p2[2] << 8) | p2[1]);
+                const quint16 p16_4 = ((p2[5] << 8) | p2[4]);
+                const quint16 result = AVG16(AVG16(p16_1, p16_2), AVG16(p16_3, p16_4));
+                q[1] = (result & 0xff);
+                q[2] = (result >> 8);
+            }
+        }
+
+        return dest;
+    }
+    if ((source.format() != QImage::Format_ARGB32_Premultiplied)
+        && (source.format() != QImage::Format_RGB32)) {
+        srcImage = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
+    dest.setDevicePixelRatio(source.devicePixelRatio());
+
+    auto src = reinterpret_cast<const quint32 *>(const_cast<const QImage &>(srcImage).bits());
+    const qsizetype sx = (srcImage.bytesPerLine() >> 2);
+    const qsizetype sx2 = (sx << 1);
+
+    auto dst = reinterpret_cast<quint32 *>(dest.bits());
+    const qsizetype dx = (dest.bytesPerLine() >> 2);
+    const int ww = dest.width();
+    const int hh = dest.height();
+
+    for (int y = hh; y; --y, dst += dx, src += sx2) {
+        const quint32 *p1 = src;
+        const quint32 *p2 = (src + sx);
+        quint32 *q = dst;
+        for (int x = ww; x; --x, q++, p1 += 2, p2 += 2) {
+            *q = AVG(AVG(p1[0], p1[1]), AVG(p2[0], p2[1]));
+        }
+    }
+
+    return dest;
+}
+
+[[maybe_unused]] static inline void qt_blurImage(QPainter *p, QImage &blurImage,
+    qreal radius, const bool quality, const bool alphaOnly, const int transposed = 0)
+{
+    if ((blurImage.format() != QImage::Format_ARGB32_Premultiplied)
+        && (blurImage.format() != QImage::Format_RGB32)) {
+        blurImage = blurImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    qreal scale = 1.0;
+    if ((radius >= 4) && (blurImage.width() >= 2) && (blurImage.height() >= 2)) {
+        blurImage = qt_halfScaled(blurImage);
+        scale = 2.0;
+        radius *= 0.5;
+    }
+
+    if (alphaOnly) {
+        expblur<12, 10, true>(blurImage, radius, quality, transposed);
+    } else {
+        expblur<12, 10, false>(blurImage, radius, quality, transposed);
+    }
+
+    if (p) {
+        p->save();
+        p->setRenderHints(QPainter::Antialiasing |
+            QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
+        p->scale(scale, scale);
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 2, 0))
+        const QSize imageSize = blurImage.deviceIndependentSize().toSize();
+#else
+        const QSize imageSize = QSizeF(QSizeF(blurImage.size()) / blurImage.devicePixelRatio()).toSize();
+#endif
+        p->drawImage(QRect(QPoint(0, 0), imageSize), blurImage);
+        p->restore();
+    }
+}
+
+[[maybe_unused]] static inline void qt_blurImage(QImage &blurImage,
+    const qreal radius, const bool quality, const int transposed = 0)
+{
+    if ((blurImage.format() == QImage::Format_Indexed8)
+        || (blurImage.format() == QImage::Format_Grayscale8)) {
+        expblur<12, 10, true>(blurImage, radius, quality, transposed);
+    } else {
+        expblur<12, 10, false>(blurImage, radius, quality, transposed);
+    }
+}
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+
+// Blurs "count" pixels that are "step" pixels apart with a box of the given radius,
+// "passes" times in a row. Three passes are already very close to a gaussian blur.
+// Thanks to the running sums the cost per pixel doesn't depend on the radius at all.
+// "buffer" needs room for "count" pixels, the edges are clamped.
+static inline void qt_boxblur_line(quint32 *pixels, const qsizetype step, const int count,
+    const int radius, const int passes, quint32 *buffer)
+{
+    if ((count < 2) || (radius < 1)) {
+        return;
+    }
+    const int window = ((radius * 2) + 1);
+    // Fixed-point reciprocal of the window size, 255 * window * inverse still fits into 32 bits.
+    const quint32 inverse = (((1u << 23) + (window / 2)) / window);
+    const auto pixelAt = [pixels, step, count](const int index) -> quint32 {
+        return pixels[qBound(0, index, (count - 1)) * step];
+    };
+    for (int pass = 0; pass != passes; ++pass) {
+        quint32 sum[4] = {};
+        for (int i = -radius; i <= radius; ++i) {
+            const quint32 pixel = pixelAt(i);
+            for (int c = 0; c != 4; ++c) {
+                sum[c] += ((pixel >> (c * 8)) & 0xff);
+            }
+        }
+        for (int i = 0; i != count; ++i) {
+            quint32 result = 0;
+            for (int c = 0; c != 4; ++c) {
+                result |= ((((sum[c] * inverse) + (1u << 22)) >> 23) << (c * 8));
+            }
+            buffer[i] = result;
+            const quint32 leaving = pixelAt(i - radius);
+            const quint32 entering = pixelAt(i + radius + 1);
+            for (int c = 0; c != 4; ++c) {
+                sum[c] += (((entering >> (c * 8)) & 0xff) - ((leaving >> (c * 8)) & 0xff));
+            }
+        }
+        for (int i = 0; i != count; ++i) {
+            pixels[i * step] = buffer[i];
+        }
+    }
+}
+
+// One step down the dual filter (Kawase) pyramid: every destination pixel is the weighted
+// average of the 2x2 block right under it (counted four times) and the four 2x2 blocks
+// diagonally next to it, which is what the GPU version gets from five bilinear samples.
+static inline void qt_kawase_downsample(const quint32 *src, const int sw, const int sh, const qsizetype sstride,
+    quint32 *dst, const int dw, const qsizetype dstride, const int firstRow, const int lastRow)
+{
+    const auto addBlock = [src, sw, sh, sstride](quint32 *sum, const int x, const int y, const quint32 weight) -> void {
+        const int x0 = qBound(0, x, (sw - 1));
+        const int x1 = qBound(0, (x + 1), (sw - 1));
+        const int y0 = qBound(0, y, (sh - 1));
+        const int y1 = qBound(0, (y + 1), (sh - 1));
+        const quint32 pixels[4] = {src[(y0 * sstride) + x0], src[(y0 * sstride) + x1],
+                                   src[(y1 * sstride) + x0], src[(y1 * sstride) + x1]};
+        for (int c = 0; c != 4; ++c) {
+            const quint32 value = (((pixels[0] >> (c * 8)) & 0xff) + ((pixels[1] >> (c * 8)) & 0xff)
+                + ((pixels[2] >> (c * 8)) & 0xff) + ((pixels[3] >> (c * 8)) & 0xff));
+            sum[c] += (value * weight);
+        }
+    };
+    for (int y = firstRow; y != lastRow; ++y) {
+        quint32 *line = (dst + (y * dstride));
+        for (int x = 0; x != dw; ++x) {
+            quint32 sum[4] = {};
+            addBlock(sum, (x * 2), (y * 2), 4);
+            addBlock(sum, ((x * 2) - 1), ((y * 2) - 1), 1);
+            addBlock(sum, ((x * 2) + 1), ((y * 2) - 1), 1);
+            addBlock(sum, ((x * 2) - 1), ((y * 2) + 1), 1);
+            addBlock(sum, ((x * 2) + 1), ((y * 2) + 1), 1);
+            quint32 result = 0;
+            for (int c = 0; c != 4; ++c) {
+                result |= (((sum[c] + 16) >> 5) << (c * 8));
+            }
+            line[x] = result;
+        }
+    }
+}
+
+// One step up the dual filter pyramid: eight bilinear samples around the destination
+// pixel, one source pixel away along the axes (weight 1) and half a pixel away along
+// the diagonals (weight 2). Coordinates are in 24.8 fixed-point.
+static inline void qt_kawase_upsample(const quint32 *src, const int sw, const int sh, const qsizetype sstride,
+    quint32 *dst, const int dw, const int dh, const qsizetype dstride, const int firstRow, const int lastRow)
+{
+    const auto addSample = [src, sw, sh, sstride](quint32 *sum, const int u, const int v, const quint32 weight) -> void {
+        // Pixel centers are at +0.5, so move to the top left one of the four neighbours.
+        const int gu = (u - 128);
+        const int gv = (v - 128);
+        const int x = ((gu >= 0) ? (gu >> 8) : -((255 - gu) >> 8));
+        const int y = ((gv >= 0) ? (gv >> 8) : -((255 - gv) >> 8));
+        const quint32 fx = quint32(gu - (x * 256));
+        const quint32 fy = quint32(gv - (y * 256));
+        const int x0 = qBound(0, x, (sw - 1));
+        const int x1 = qBound(0, (x + 1), (sw - 1));
+        const int y0 = qBound(0, y, (sh - 1));
+        const int y1 = qBound(0, (y + 1), (sh - 1));
+        const quint32 pixels[4] = {src[(y0 * sstride) + x0], src[(y0 * sstride) + x1],
+                                   src[(y1 * sstride) + x0], src[(y1 * sstride) + x1]};
+        const quint32 weights[4] = {((256 - fx) * (256 - fy)), (fx * (256 - fy)), ((256 - fx) * fy), (fx * fy)};
+        for (int c = 0; c != 4; ++c) {
+            quint32 value = 0;
+            for (int i = 0; i != 4; ++i) {
+                value += (((pixels[i] >> (c * 8)) & 0xff) * weights[i]);
+            }
+            sum[c] += (value * weight);
+        }
+    };
+    for (int y = firstRow; y != lastRow; ++y) {
+        quint32 *line = (dst + (y * dstride));
+        const int v = int((((qint64(y) * 2) + 1) * sh * 128) / dh);
+        for (int x = 0; x != dw; ++x) {
+            const int u = int((((qint64(x) * 2) + 1) * sw * 128) / dw);
+            quint32 sum[4] = {};
+            addSample(sum, (u - 256), v, 1);
+            addSample(sum, (u + 256), v, 1);
+            addSample(sum, u, (v - 256), 1);
+            addSample(sum, u, (v + 256), 1);
+            addSample(sum, (u - 128), (v - 128), 2);
+            addSample(sum, (u + 128), (v - 128), 2);
+            addSample(sum, (u - 128), (v + 128), 2);
+            addSample(sum, (u + 128), (v + 128), 2);
+            quint32 result = 0;
+            for (int c = 0; c != 4; ++c) {
+                // The weights add up to 12 * 256 * 256.
+                result |= (((sum[c] + (6u << 16)) / (12u << 16)) << (c * 8));
+            }
+            line[x] = result;
+        }
+    }
+}
+
+// "radius" has the same meaning as for the exponential blur: a gaussian with a standard
+// deviation of half the radius, which is what "passes" box blurs in a row add up to.
+static inline void qt_boxblur(QImage &img, const qreal radius, const int passes)
+{
+    Q_ASSERT(img.format() == QImage::Format_ARGB32_Premultiplied);
+    if ((img.format() != QImage::Format_ARGB32_Premultiplied) || (passes < 1)) {
+        return;
+    }
+    const qreal sigma = (radius * 0.5);
+    const int boxRadius = qMax(1, qRound((std::sqrt(((qreal(12) * sigma * sigma) / qreal(passes)) + qreal(1)) - qreal(1)) * qreal(0.5)));
+    const int w = img.width();
+    const int h = img.height();
+    const qsizetype stride = (img.bytesPerLine() >> 2);
+    const auto bits = reinterpret_cast<quint32 *>(img.bits());
+    static constexpr const int kRowsPerChunk = 32;
+    qt_blurParallelFor(h, kRowsPerChunk, [&](const int firstRow, const int lastRow) -> void {
+        QVarLengthArray<quint32, 4096> buffer(w);
+        for (int y = firstRow; y != lastRow; ++y) {
+            qt_boxblur_line((bits + (y * stride)), 1, w, boxRadius, passes, buffer.data());
+        }
+    });
+    // Neighbouring columns share their cache lines, so every thread takes a whole strip of them.
+    static constexpr const int kColumnsPerChunk = 16;
+    qt_blurParallelFor(w, kColumnsPerChunk, [&](const int firstColumn, const int lastColumn) -> void {
+        QVarLengthArray<quint32, 4096> buffer(h);
+        for (int x = firstColumn; x != lastColumn; ++x) {
+            qt_boxblur_line((bits + x), stride, h, boxRadius, passes, buffer.data());
+        }
+    });
+}
+
+[[nodiscard]] static inline QImage qt_kawaseblur(const QImage &img, const qreal radius, const MicaBlurQuality quality)
+{
+    Q_ASSERT(img.format() == QImage::Format_ARGB32_Premultiplied);
+    if (img.format() != QImage::Format_ARGB32_Premultiplied) {
+        return img;
+    }
+    static constexpr const int kRowsPerChunk = 32;
+    // Every level of the pyramid doubles the reach of the blur, and nearly all of the
+    // work is done at the small levels.
+    const int levelCount = qBound(1, (qRound(std::log2(qMax(radius, qreal(2)))) - 1), 10);
+    QList<QImage> pyramid = {img};
+    for (int i = 0; i != levelCount; ++i) {
+        const QImage src = pyramid.last();
+        if ((src.width() < 4) || (src.height() < 4)) {
+            break;
+        }
+        QImage dst((src.width() / 2), (src.height() / 2), QImage::Format_ARGB32_Premultiplied);
+        // QImage::bits() may detach, which must never happen on the pool threads, so
+        // everything the kernel needs is taken out of the images here, just once.
+        const auto srcBits = reinterpret_cast<const quint32 *>(src.constBits());
+        const int sw = src.width();
+        const int sh = src.height();
+        const qsizetype sstride = (src.bytesPerLine() >> 2);
+        const auto dstBits = reinterpret_cast<quint32 *>(dst.bits());
+        const int dw = dst.width();
+        const qsizetype dstride = (dst.bytesPerLine() >> 2);
+        qt_blurParallelFor(dst.height(), kRowsPerChunk,
+            [srcBits, sw, sh, sstride, dstBits, dw, dstride](const int firstRow, const int lastRow) -> void {
+                qt_kawase_downsample(srcBits, sw, sh, sstride, dstBits, dw, dstride, firstRow, lastRow);
+            });
+        pyramid.append(dst);
+    }
+    for (qsizetype i = (pyramid.size() - 1); i > 0; --i) {
+        const QImage src = pyramid.at(i);
+        const QSize size = pyramid.at(i - 1).size();
+        if ((i == 1) && (quality == MicaBlurQuality::Speed)) {
+            // The last step is the most expensive one, a plain bilinear scale is good enough here.
+            pyramid[i - 1] = src.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            break;
+        }
+        QImage dst(size, QImage::Format_ARGB32_Premultiplied);
+        const auto srcBits = reinterpret_cast<const quint32 *>(src.constBits());
+        const int sw = src.width();
+        const int sh = src.height();
+        const qsizetype sstride = (src.bytesPerLine() >> 2);
+        const auto dstBits = reinterpret_cast<quint32 *>(dst.bits());
+        const int dw = dst.width();
+        const int dh = dst.height();
+        const qsizetype dstride = (dst.bytesPerLine() >> 2);
+        qt_blurParallelFor(dh, kRowsPerChunk,
+            [srcBits, sw, sh, sstride, dstBits, dw, dh, dstride](const int firstRow, const int lastRow) -> void {
+                qt_kawase_upsample(srcBits, sw, sh, sstride, dstBits, dw, dh, dstride, firstRow, lastRow);
+            });
+        pyramid[i - 1] = dst;
+    }
+    QImage result = pyramid.first();
+    if (quality == MicaBlurQuality::Quality) {
+        // Smooths out the faint blockiness the pyramid leaves behind.
+        qt_boxblur(result, 4, 2);
+    }
+    return result;
+}
+
+void MicaBlur::blurImage(QPainter *painter, QImage &image, const qreal radius,
+    const MicaBlurAlgorithm algorithm, const MicaBlurQuality quality)
+{
+    Q_ASSERT(painter);
+    if (!painter) {
+        return;
+    }
+    static constexpr const QPoint originPoint = {0, 0};
+    switch (algorithm) {
+    case MicaBlurAlgorithm::Box: {
+        const int passes = ((quality == MicaBlurQuality::Speed) ? 2 : ((quality == MicaBlurQuality::Quality) ? 4 : 3));
+        if ((quality == MicaBlurQuality::Quality) || (radius < 4) || (image.width() < 2) || (image.height() < 2)) {
+            qt_boxblur(image, radius, passes);
+            painter->drawImage(originPoint, image);
+            break;
+        }
+        // Blurring a half sized image is four times as fast, and looks the same after this much blur.
+        QImage halfScaled = image.scaled((image.width() / 2), (image.height() / 2),
+            Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        qt_boxblur(halfScaled, (radius * 0.5), passes);
+        painter->drawImage(QRect(originPoint, image.size()), halfScaled);
+    } break;
+    case MicaBlurAlgorithm::DualKawase:
+        painter->drawImage(originPoint, qt_kawaseblur(image, radius, quality));
+        break;
+    case MicaBlurAlgorithm::Exponential:
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+        painter->drawImage(originPoint, image);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+        if (quality == MicaBlurQuality::Quality) {
+            // Skips the half scaling qt_blurImage() does.
+            expblur<12, 10, false>(image, radius, true);
+            painter->drawImage(originPoint, image);
+        } else {
+            qt_blurImage(painter, image, radius, (quality == MicaBlurQuality::Balanced), false);
+        }
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+        break;
+    }
+}
+
+bool MicaBlur::isRowKernelSupported(const RowKernel kernel)
+{
+    switch (kernel) {
+    case RowKernel::Auto:
+    case RowKernel::Scalar:
+        return true;
+    case RowKernel::SSE2:
+#ifdef FRAMELESSHELPER_HAS_BLUR_SSE2
+        return true;
+#else // !FRAMELESSHELPER_HAS_BLUR_SSE2
+        return false;
+#endif // FRAMELESSHELPER_HAS_BLUR_SSE2
+    case RowKernel::AVX2:
+#ifdef FRAMELESSHELPER_HAS_BLUR_AVX2
+        return qCpuHasFeature(AVX2);
+#else // !FRAMELESSHELPER_HAS_BLUR_AVX2
+        return false;
+#endif // FRAMELESSHELPER_HAS_BLUR_AVX2
+    }
+    return false;
+}
+
+void MicaBlur::setRowKernel(const RowKernel kernel)
+{
+    if (!isRowKernelSupported(kernel)) {
+        return;
+    }
+    g_rowKernel.store(kernel, std::memory_order_relaxed);
+}
+
+QThreadPool *MicaBlur::threadPool()
+{
+    return g_micaBlurThreadPool();
+}
+
+void MicaBlur::exponentialBlur(QImage &image, const qreal radius, const bool improvedQuality)
+{
+#ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
+    Q_UNUSED(image);
+    Q_UNUSED(radius);
+    Q_UNUSED(improvedQuality);
+#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
+    qt_blurImage(image, radius, improvedQuality);
+#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+}
+
+void MicaBlur::boxBlur(QImage &image, const qreal radius, const int passes)
+{
+    qt_boxblur(image, radius, passes);
+}
+
+QImage MicaBlur::kawaseBlur(const QImage &image, const qreal radius, const MicaBlurQuality quality)
+{
+    return qt_kawaseblur(image, radius, quality);
+}
+
+FRAMELESSHELPER_END_NAMESPACE
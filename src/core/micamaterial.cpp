@@ -24,19 +24,31 @@
 
 #include "micamaterial.h"
 #include "micamaterial_p.h"
+#include "micablur_p.h"
 #include "framelessmanager.h"
 #include "utils.h"
 #include "framelessconfig_p.h"
 #include <QtCore/qsysinfo.h>
 #include <QtCore/qmutex.h>
-#include <QtGui/qpixmap.h>
+#include <QtCore/qhash.h>
+#include <QtCore/qmath.h>
+#include <QtCore/qthreadpool.h>
+#include <QtCore/qrunnable.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qtimer.h>
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qdatetime.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qstandardpaths.h>
+#include <QtCore/qcryptographichash.h>
 #include <QtGui/qimage.h>
+#include <QtGui/qimagereader.h>
 #include <QtGui/qpainter.h>
 #include <QtGui/qscreen.h>
 #include <QtGui/qguiapplication.h>
-#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
-#  include <QtGui/private/qmemrotate_p.h>
-#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
 
 #ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 // The "Q_INIT_RESOURCE()" macro can't be used within a namespace,
@@ -70,366 +82,94 @@ using namespace Global;
 [[maybe_unused]] static constexpr const qreal kDefaultTintOpacity = 0.7;
 [[maybe_unused]] static constexpr const qreal kDefaultNoiseOpacity = 0.04;
 [[maybe_unused]] static constexpr const qreal kDefaultBlurRadius = 128.0;
+[[maybe_unused]] static constexpr const int kWallpaperDownscaleFactor = 4;
+[[maybe_unused]] static constexpr const int kDefaultCacheIdleTimeout = 60000; // 1 minute.
 
 [[maybe_unused]] static Q_CONSTEXPR2 const QColor kDefaultSystemLightColor2 = {243, 243, 243}; // #F3F3F3
 
+// Bump the version whenever the generated image changes for the same input.
+[[maybe_unused]] static constexpr const quint32 kWallpaperCacheMagic = 0x574D4846; // "FHMW"
+[[maybe_unused]] static constexpr const quint32 kWallpaperCacheVersion = 4;
+[[maybe_unused]] static constexpr const int kWallpaperCacheMaxFileCount = 8;
+[[maybe_unused]] static constexpr const qint64 kWallpaperCacheMaxTotalSize = (256 * 1024 * 1024);
+
+FRAMELESSHELPER_STRING_CONSTANT2(WallpaperCacheDirName, "FramelessHelper/mica")
+FRAMELESSHELPER_STRING_CONSTANT2(WallpaperCacheFileSuffix, ".bin")
+FRAMELESSHELPER_STRING_CONSTANT2(WallpaperCacheFileFilter, "*.bin")
+
 #ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 FRAMELESSHELPER_STRING_CONSTANT2(NoiseImageFilePath, ":/org.wangwenx190.FramelessHelper/resources/images/noise.png")
 #endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 
 struct MicaMaterialData
 {
+    // The blurred wallpaper of one screen, at the resolution of that screen.
+    struct WallpaperTile
+    {
+        QImage image = {};
+        QRect geometry = {}; // The device independent geometry of the screen "image" was generated for.
+        quint64 generation = 0;
+        quint64 request = 0; // The request "image" was generated by, identifies it uniquely.
+        // The request that is being processed in the background, zero if there's none.
+        quint64 pendingRequest = 0;
+        quint64 pendingGeneration = 0;
+        QRect pendingGeometry = {};
+        QSize pendingSize = {};
+    };
+    // A wallpaper tile with the tint of an instance blended over it, at the resolution of
+    // the tile. The instances with the same colors share it, and it's freed as soon as the
+    // last of them lets go of it.
+    struct SharedSurface
+    {
+        QScreen *screen = nullptr;
+        quint64 tileRequest = 0;
+        QColor placeholderColor = {}; // Depends on the system theme.
+        QColor materialColor = {};
+        std::weak_ptr<const QImage> image = {};
+    };
     QMutex mutex;
-    QPixmap blurredWallpaper = {};
-    bool graphicsResourcesReady = false;
+    QHash<QScreen *, WallpaperTile> wallpaperTiles = {};
+    QList<SharedSurface> surfaces = {};
+    // Bumped whenever the wallpaper changes, tiles of older generations are regenerated.
+    quint64 wallpaperGeneration = 0;
+    quint64 lastWallpaperRequest = 0;
+    QList<MicaMaterialPrivate *> instances = {};
+    // Bumped whenever an instance becomes active, pending idle releases are cancelled by it.
+    quint64 idleToken = 0;
+    int cacheIdleTimeout = kDefaultCacheIdleTimeout;
+    MicaBlurAlgorithm blurAlgorithm = MicaBlurAlgorithm::Exponential;
+    MicaBlurQuality blurQuality = MicaBlurQuality::Balanced;
 };
 
 Q_GLOBAL_STATIC(MicaMaterialData, g_micaMaterialData)
 
-#ifndef FRAMELESSHELPER_CORE_NO_PRIVATE
-template<const int shift>
-[[nodiscard]] static inline constexpr int qt_static_shift(const int value)
-{
-    if constexpr (shift == 0) {
-        return value;
-    } else if constexpr (shift > 0) {
-        return (value << (quint32(shift) & 0x1f));
-    } else {
-        return (value >> (quint32(-shift) & 0x1f));
-    }
-}
-
-template<const int aprec, const int zprec>
-static inline void qt_blurinner(uchar *bptr, int &zR, int &zG, int &zB, int &zA, const int alpha)
-{
-    const auto pixel = reinterpret_cast<QRgb *>(bptr);
-
-#define Z_MASK (0xff << zprec)
-    const int A_zprec = (qt_static_shift<zprec - 24>(*pixel) & Z_MASK);
-    const int R_zprec = (qt_static_shift<zprec - 16>(*pixel) & Z_MASK);
-    const int G_zprec = (qt_static_shift<zprec - 8>(*pixel)  & Z_MASK);
-    const int B_zprec = (qt_static_shift<zprec>(*pixel)      & Z_MASK);
-#undef Z_MASK
-
-    const int zR_zprec = (zR >> aprec);
-    const int zG_zprec = (zG >> aprec);
-    const int zB_zprec = (zB >> aprec);
-    const int zA_zprec = (zA >> aprec);
-
-    zR += (alpha * (R_zprec - zR_zprec));
-    zG += (alpha * (G_zprec - zG_zprec));
-    zB += (alpha * (B_zprec - zB_zprec));
-    zA += (alpha * (A_zprec - zA_zprec));
-
-#define ZA_MASK (0xff << (zprec + aprec))
-    *pixel = (qt_static_shift<24 - zprec - aprec>(zA & ZA_MASK)
-        | qt_static_shift<16 - zprec - aprec>(zR & ZA_MASK)
-        | qt_static_shift<8 - zprec - aprec>(zG & ZA_MASK)
-        | qt_static_shift<-zprec - aprec>(zB & ZA_MASK));
-#undef ZA_MASK
-}
-
-static constexpr const int alphaIndex = ((QSysInfo::ByteOrder == QSysInfo::BigEndian) ? 0 : 3);
-
-template<const int aprec, const int zprec>
-static inline void qt_blurinner_alphaOnly(uchar *bptr, int &z, const int alpha)
+// The caller must hold the lock.
+static inline void pruneSharedSurfaces()
 {
-    const int A_zprec = (int(*(bptr)) << zprec);
-    const int z_zprec = (z >> aprec);
-    z += (alpha * (A_zprec - z_zprec));
-    *(bptr) = (z >> (zprec + aprec));
-}
-
-template<const int aprec, const int zprec, const bool alphaOnly>
-static inline void qt_blurrow(QImage &im, const int line, const int alpha)
-{
-    uchar *bptr = im.scanLine(line);
-
-    int zR = 0, zG = 0, zB = 0, zA = 0;
-
-#ifdef Q_CC_MSVC
-#  pragma warning(push)
-#  pragma warning(disable:4127) // false alarm.
-#endif // Q_CC_MSVC
-    if (alphaOnly && (im.format() != QImage::Format_Indexed8)) {
-        bptr += alphaIndex;
-    }
-#ifdef Q_CC_MSVC
-#  pragma warning(pop)
-#endif // Q_CC_MSVC
-
-    const int stride = (im.depth() >> 3);
-    const int im_width = im.width();
-    for (int index = 0; index != im_width; ++index) {
-        if (alphaOnly) {
-            qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA, alpha);
-        } else {
-            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
-        }
-        bptr += stride;
-    }
-
-    bptr -= stride;
-
-    for (int index = (im_width - 2); index >= 0; --index) {
-        bptr -= stride;
-        if (alphaOnly) {
-            qt_blurinner_alphaOnly<aprec, zprec>(bptr, zA, alpha);
+    QList<MicaMaterialData::SharedSurface> &surfaces = g_micaMaterialData()->surfaces;
+    for (auto it = surfaces.begin(); it != surfaces.end();) {
+        if (it->image.expired()) {
+            it = surfaces.erase(it);
         } else {
-            qt_blurinner<aprec, zprec>(bptr, zR, zG, zB, zA, alpha);
+            ++it;
         }
     }
 }
 
-/*
-*  expblur(QImage &img, int radius)
-*
-*  Based on exponential blur algorithm by Jani Huhtanen
-*
-*  In-place blur of image 'img' with kernel
-*  of approximate radius 'radius'.
-*
-*  Blurs with two sided exponential impulse
-*  response.
-*
-*  aprec = precision of alpha parameter
-*  in fixed-point format 0.aprec
-*
-*  zprec = precision of state parameters
-*  zR,zG,zB and zA in fp format 8.zprec
-*/
-template<const int aprec, const int zprec, const bool alphaOnly>
-static inline void expblur(QImage &img, qreal radius, const bool improvedQuality = false, const int transposed = 0)
-{
-    Q_ASSERT((img.format() == QImage::Format_ARGB32_Premultiplied)
-             || (img.format() == QImage::Format_RGB32)
-             || (img.format() == QImage::Format_Indexed8)
-             || (img.format() == QImage::Format_Grayscale8));
-    if ((img.format() != QImage::Format_ARGB32_Premultiplied)
-        && (img.format() != QImage::Format_RGB32)
-        && (img.format() != QImage::Format_Indexed8)
-        && (img.format() != QImage::Format_Grayscale8)) {
-        return;
-    }
-
-    // halve the radius if we're using two passes
-    if (improvedQuality) {
-        radius *= 0.5;
-    }
-
-    // choose the alpha such that pixels at radius distance from a fully
-    // saturated pixel will have an alpha component of no greater than
-    // the cutOffIntensity
-    static constexpr const qreal cutOffIntensity = 2.0;
-    const int alpha = ((radius <= qreal(1e-5)) ? ((1 << aprec) - 1) :
-        std::round((1 << aprec) * (1 - qPow(cutOffIntensity / qreal(255), qreal(1) / radius))));
-
-    int img_height = img.height();
-    for (int row = 0; row != img_height; ++row) {
-        for (int i = 0; i <= int(improvedQuality); ++i) {
-            qt_blurrow<aprec, zprec, alphaOnly>(img, row, alpha);
-        }
-    }
-
-    QImage temp(img.height(), img.width(), img.format());
-    temp.setDevicePixelRatio(img.devicePixelRatio());
-
-    if (transposed >= 0) {
-        if (img.depth() == 8) {
-            qt_memrotate270(reinterpret_cast<const quint8 *>(img.bits()),
-                            img.width(), img.height(), img.bytesPerLine(),
-                            reinterpret_cast<quint8 *>(temp.bits()),
-                            temp.bytesPerLine());
-        } else {
-            qt_memrotate270(reinterpret_cast<const quint32 *>(img.bits()),
-                            img.width(), img.height(), img.bytesPerLine(),
-                            reinterpret_cast<quint32 *>(temp.bits()),
-                            temp.bytesPerLine());
-        }
-    } else {
-        if (img.depth() == 8) {
-            qt_memrotate90(reinterpret_cast<const quint8 *>(img.bits()),
-                           img.width(), img.height(), img.bytesPerLine(),
-                           reinterpret_cast<quint8 *>(temp.bits()),
-                           temp.bytesPerLine());
-        } else {
-            qt_memrotate90(reinterpret_cast<const quint32 *>(img.bits()),
-                           img.width(), img.height(), img.bytesPerLine(),
-                           reinterpret_cast<quint32 *>(temp.bits()),
-                           temp.bytesPerLine());
-        }
-    }
-
-    img_height = temp.height();
-    for (int row = 0; row != img_height; ++row) {
-        for (int i = 0; i <= int(improvedQuality); ++i) {
-            qt_blurrow<aprec, zprec, alphaOnly>(temp, row, alpha);
-        }
-    }
-
-    if (transposed == 0) {
-        if (img.depth() == 8) {
-            qt_memrotate90(reinterpret_cast<const quint8 *>(temp.bits()),
-                           temp.width(), temp.height(), temp.bytesPerLine(),
-                           reinterpret_cast<quint8 *>(img.bits()),
-                           img.bytesPerLine());
-        } else {
-            qt_memrotate90(reinterpret_cast<const quint32 *>(temp.bits()),
-                           temp.width(), temp.height(), temp.bytesPerLine(),
-                           reinterpret_cast<quint32 *>(img.bits()),
-                           img.bytesPerLine());
-        }
-    } else {
-        img = temp;
-    }
-}
-
-#define AVG(a,b)  ( ((((a)^(b)) & 0xfefefefeUL) >> 1) + ((a)&(b)) )
-#define AVG16(a,b)  ( ((((a)^(b)) & 0xf7deUL) >> 1) + ((a)&(b)) )
-
-[[nodiscard]] static inline QImage qt_halfScaled(const QImage &source)
-{
-    if ((source.width() < 2) || (source.height() < 2)) {
-        return {};
-    }
-
-    QImage srcImage = source;
-
-    if ((source.format() == QImage::Format_Indexed8)
-        || (source.format() == QImage::Format_Grayscale8)) {
-        // assumes grayscale
-        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
-        dest.setDevicePixelRatio(source.devicePixelRatio());
-
-        auto src = reinterpret_cast<const uchar *>(const_cast<const QImage &>(srcImage).bits());
-        const qsizetype sx = srcImage.bytesPerLine();
-        const qsizetype sx2 = (sx << 1);
-
-        auto dst = reinterpret_cast<uchar *>(dest.bits());
-        const qsizetype dx = dest.bytesPerLine();
-        const int ww = dest.width();
-        const int hh = dest.height();
-
-        for (int y = hh; y; --y, dst += dx, src += sx2) {
-            const uchar *p1 = src;
-            const uchar *p2 = (src + sx);
-            uchar *q = dst;
-            for (int x = ww; x; --x, ++q, p1 += 2, p2 += 2) {
-                *q = (((int(p1[0]) + int(p1[1]) + int(p2[0]) + int(p2[1])) + 2) >> 2);
-            }
-        }
-
-        return dest;
-    }
-    if (source.format() == QImage::Format_ARGB8565_Premultiplied) {
-        QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
-        dest.setDevicePixelRatio(source.devicePixelRatio());
-
-        auto src = reinterpret_cast<const uchar *>(const_cast<const QImage &>(srcImage).bits());
-        const qsizetype sx = srcImage.bytesPerLine();
-        const qsizetype sx2 = (sx << 1);
-
-        auto dst = reinterpret_cast<uchar *>(dest.bits());
-        const qsizetype dx = dest.bytesPerLine();
-        const int ww = dest.width();
-        const int hh = dest.height();
-
-        for (int y = hh; y; --y, dst += dx, src += sx2) {
-            const uchar *p1 = src;
-            const uchar *p2 = (src + sx);
-            uchar *q = dst;
-            for (int x = ww; x; --x, q += 3, p1 += 6, p2 += 6) {
-                // alpha
-                q[0] = AVG(AVG(p1[0], p1[3]), AVG(p2[0], p2[3]));
-                // rgb
-                const quint16 p16_1 = ((p1[2] << 8) | p1[1]);
-                const quint16 p16_2 = ((p1[5] << 8) | p1[4]);
-                const quint16 p16_3 = ((p2[2] << 8) | p2[1]);
-                const quint16 p16_4 = ((p2[5] << 8) | p2[4]);
-                const quint16 result = AVG16(AVG16(p16_1, p16_2), AVG16(p16_3, p16_4));
-                q[1] = (result & 0xff);
-                q[2] = (result >> 8);
-            }
-        }
-
-        return dest;
-    }
-    if ((source.format() != QImage::Format_ARGB32_Premultiplied)
-        && (source.format() != QImage::Format_RGB32)) {
-        srcImage = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-    }
-
-    QImage dest(source.width() / 2, source.height() / 2, srcImage.format());
-    dest.setDevicePixelRatio(source.devicePixelRatio());
-
-    auto src = reinterpret_cast<const quint32 *>(const_cast<const QImage &>(srcImage).bits());
-    const qsizetype sx = (srcImage.bytesPerLine() >> 2);
-    const qsizetype sx2 = (sx << 1);
-
-    auto dst = reinterpret_cast<quint32 *>(dest.bits());
-    const qsizetype dx = (dest.bytesPerLine() >> 2);
-    const int ww = dest.width();
-    const int hh = dest.height();
-
-    for (int y = hh; y; --y, dst += dx, src += sx2) {
-        const quint32 *p1 = src;
-        const quint32 *p2 = (src + sx);
-        quint32 *q = dst;
-        for (int x = ww; x; --x, q++, p1 += 2, p2 += 2) {
-            *q = AVG(AVG(p1[0], p1[1]), AVG(p2[0], p2[1]));
-        }
-    }
-
-    return dest;
-}
-
-[[maybe_unused]] static inline void qt_blurImage(QPainter *p, QImage &blurImage,
-    qreal radius, const bool quality, const bool alphaOnly, const int transposed = 0)
+class MicaMaterialTask : public QRunnable
 {
-    if ((blurImage.format() != QImage::Format_ARGB32_Premultiplied)
-        && (blurImage.format() != QImage::Format_RGB32)) {
-        blurImage = blurImage.convertToFormat(QImage::Format_ARGB32_Premultiplied);
-    }
+public:
+    explicit MicaMaterialTask(std::function<void()> function) : m_function(std::move(function)) {}
+    ~MicaMaterialTask() override = default;
 
-    qreal scale = 1.0;
-    if ((radius >= 4) && (blurImage.width() >= 2) && (blurImage.height() >= 2)) {
-        blurImage = qt_halfScaled(blurImage);
-        scale = 2.0;
-        radius *= 0.5;
+    void run() override
+    {
+        m_function();
     }
 
-    if (alphaOnly) {
-        expblur<12, 10, true>(blurImage, radius, quality, transposed);
-    } else {
-        expblur<12, 10, false>(blurImage, radius, quality, transposed);
-    }
-
-    if (p) {
-        p->save();
-        p->setRenderHints(QPainter::Antialiasing |
-            QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-        p->scale(scale, scale);
-#if (QT_VERSION >= QT_VERSION_CHECK(6, 2, 0))
-        const QSize imageSize = blurImage.deviceIndependentSize().toSize();
-#else
-        const QSize imageSize = QSizeF(QSizeF(blurImage.size()) / blurImage.devicePixelRatio()).toSize();
-#endif
-        p->drawImage(QRect(QPoint(0, 0), imageSize), blurImage);
-        p->restore();
-    }
-}
-
-[[maybe_unused]] static inline void qt_blurImage(QImage &blurImage,
-    const qreal radius, const bool quality, const int transposed = 0)
-{
-    if ((blurImage.format() == QImage::Format_Indexed8)
-        || (blurImage.format() == QImage::Format_Grayscale8)) {
-        expblur<12, 10, true>(blurImage, radius, quality, transposed);
-    } else {
-        expblur<12, 10, false>(blurImage, radius, quality, transposed);
-    }
-}
-#endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+private:
+    std::function<void()> m_function = nullptr;
+};
 
 /*!
     Transforms an \a alignment of Qt::AlignLeft or Qt::AlignRight
@@ -492,7 +232,15 @@ MicaMaterialPrivate::MicaMaterialPrivate(MicaMaterial *q) : QObject(q)
     initialize();
 }
 
-MicaMaterialPrivate::~MicaMaterialPrivate() = default;
+MicaMaterialPrivate::~MicaMaterialPrivate()
+{
+    g_micaMaterialData()->mutex.lock();
+    g_micaMaterialData()->instances.removeAll(this);
+    g_micaMaterialData()->mutex.unlock();
+    if (active) {
+        scheduleIdleRelease();
+    }
+}
 
 MicaMaterialPrivate *MicaMaterialPrivate::get(MicaMaterial *q)
 {
@@ -512,75 +260,451 @@ const MicaMaterialPrivate *MicaMaterialPrivate::get(const MicaMaterial *q)
     return q->d_func();
 }
 
-void MicaMaterialPrivate::maybeGenerateBlurredWallpaper(const bool force)
+// The pixel size of the tile of a screen, its native resolution shrunk by the given scale.
+[[nodiscard]] static inline QSize wallpaperTileSize(const QRect &geometry, const qreal devicePixelRatio, const int scale)
 {
-    g_micaMaterialData()->mutex.lock();
-    if (!g_micaMaterialData()->blurredWallpaper.isNull() && !force) {
-        g_micaMaterialData()->mutex.unlock();
-        return;
+    const QSizeF size = (QSizeF(geometry.size()) * devicePixelRatio / qreal(qMax(scale, 1)));
+    return {qMax(1, qCeil(size.width())), qMax(1, qCeil(size.height()))};
+}
+
+// Generates the blurred wallpaper of one screen. "tileRect" is the device independent
+// geometry of the screen and "layoutRect" is the area the wallpaper is laid out on: the
+// screen itself, or the whole virtual desktop for spanned wallpapers. The result is
+// "bufferSize" large, which is usually a fraction of the native resolution of the
+// screen: a blur this strong has no fine details left at all, so the down-scaled image
+// looks exactly the same once it has been scaled up again with bilinear filtering,
+// while it needs only a fraction of the memory and blurring time.
+[[nodiscard]] static inline QImage generateBlurredWallpaper(const QString &wallpaperFilePath,
+    const WallpaperAspectStyle aspectStyle, const QRect &layoutRect, const QRect &tileRect, const QSize &bufferSize,
+    const MicaBlurAlgorithm blurAlgorithm, const MicaBlurQuality blurQuality)
+{
+    QImage result(bufferSize, QImage::Format_ARGB32_Premultiplied);
+    result.fill(kDefaultTransparentColor);
+    // Wallpapers are often photos of 6K or more, and the blur throws away nearly all
+    // of their details anyway. So instead of decoding them at full resolution and
+    // scaling them down afterwards, we let the image reader decode only the part
+    // that ends up in this tile, directly at the resolution of the tile. The JPEG
+    // decoder even does most of the scaling in the DCT domain, so the full sized
+    // image never exists in memory at all.
+    QImageReader reader(wallpaperFilePath);
+    QImage fullImage = {};
+    QSize sourceSize = reader.size();
+    if (!sourceSize.isValid()) {
+        // This format can't tell its size without decoding the whole image.
+        fullImage = reader.read();
+        sourceSize = fullImage.size();
     }
-    g_micaMaterialData()->mutex.unlock();
-    const QSize size = QGuiApplication::primaryScreen()->virtualSize();
-    g_micaMaterialData()->mutex.lock();
-    g_micaMaterialData()->blurredWallpaper = QPixmap(size);
-    g_micaMaterialData()->blurredWallpaper.fill(kDefaultTransparentColor);
-    g_micaMaterialData()->mutex.unlock();
-    const QString wallpaperFilePath = Utils::getWallpaperFilePath();
-    if (wallpaperFilePath.isEmpty()) {
-        WARNING << "Failed to retrieve the wallpaper file path.";
-        return;
+    if (sourceSize.isEmpty()) {
+        WARNING << "QImage doesn't support this kind of file:" << wallpaperFilePath;
+        return result;
+    }
+    const auto decode = [&reader, &fullImage](const QSize &scaledSize, const QRect &scaledClipRect) -> QImage {
+        if (!fullImage.isNull()) {
+            return fullImage.scaled(scaledSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).copy(scaledClipRect);
+        }
+        reader.setScaledSize(scaledSize);
+        reader.setScaledClipRect(scaledClipRect);
+        return reader.read();
+    };
+    const qreal xScale = (qreal(bufferSize.width()) / qreal(tileRect.width()));
+    const qreal yScale = (qreal(bufferSize.height()) / qreal(tileRect.height()));
+    QImage image = {};
+    QRectF targetRect = {};
+    if (aspectStyle == WallpaperAspectStyle::Tile) {
+        // Tiled wallpapers keep their own size, and every copy is needed.
+        const QSize pixelSize = {qMax(1, qCeil(sourceSize.width() * xScale)), qMax(1, qCeil(sourceSize.height() * yScale))};
+        image = decode(pixelSize, QRect(QPoint(0, 0), pixelSize));
+    } else {
+        QSize newSize = sourceSize;
+        if ((aspectStyle == WallpaperAspectStyle::Stretch) || (aspectStyle == WallpaperAspectStyle::Fit)
+            || (aspectStyle == WallpaperAspectStyle::Fill) || (aspectStyle == WallpaperAspectStyle::Span)) {
+            // A spanned wallpaper fills the whole virtual desktop.
+            Qt::AspectRatioMode mode = Qt::KeepAspectRatioByExpanding;
+            if (aspectStyle == WallpaperAspectStyle::Stretch) {
+                mode = Qt::IgnoreAspectRatio;
+            } else if (aspectStyle == WallpaperAspectStyle::Fit) {
+                mode = Qt::KeepAspectRatio;
+            }
+            newSize.scale(layoutRect.size(), mode);
+        }
+        const QRect rect = alignedRect(Qt::LeftToRight, Qt::AlignCenter, newSize, layoutRect);
+        const QRect visibleRect = rect.intersected(tileRect);
+        if (visibleRect.isEmpty()) {
+            // Nothing of the wallpaper ends up in this tile.
+            return result;
+        }
+        const QSize pixelSize = {qMax(1, qCeil(rect.width() * xScale)), qMax(1, qCeil(rect.height() * yScale))};
+        const qreal xFactor = (qreal(pixelSize.width()) / qreal(rect.width()));
+        const qreal yFactor = (qreal(pixelSize.height()) / qreal(rect.height()));
+        const QRect clipRect = QRectF(((visibleRect.x() - rect.x()) * xFactor), ((visibleRect.y() - rect.y()) * yFactor),
+            (visibleRect.width() * xFactor), (visibleRect.height() * yFactor)).toAlignedRect().intersected(QRect(QPoint(0, 0), pixelSize));
+        image = decode(pixelSize, clipRect);
+        targetRect = {(rect.x() + (clipRect.x() / xFactor)), (rect.y() + (clipRect.y() / yFactor)),
+            (clipRect.width() / xFactor), (clipRect.height() / yFactor)};
     }
-    QImage image(wallpaperFilePath);
     if (image.isNull()) {
-        WARNING << "QImage doesn't support this kind of file:" << wallpaperFilePath;
-        return;
+        WARNING << "Failed to decode the wallpaper:" << wallpaperFilePath << reader.errorString();
+        return result;
     }
-    WallpaperAspectStyle aspectStyle = Utils::getWallpaperAspectStyle();
-    QImage buffer(size, QImage::Format_ARGB32_Premultiplied);
+    QImage buffer(bufferSize, QImage::Format_ARGB32_Premultiplied);
+    buffer.fill(kDefaultTransparentColor);
 #ifdef Q_OS_WINDOWS
     if (aspectStyle == WallpaperAspectStyle::Center) {
         buffer.fill(kDefaultBlackColor);
     }
 #endif
-    if ((aspectStyle == WallpaperAspectStyle::Stretch)
-        || (aspectStyle == WallpaperAspectStyle::Fit)
-        || (aspectStyle == WallpaperAspectStyle::Fill)) {
-        Qt::AspectRatioMode mode = Qt::KeepAspectRatioByExpanding;
-        if (aspectStyle == WallpaperAspectStyle::Stretch) {
-            mode = Qt::IgnoreAspectRatio;
-        } else if (aspectStyle == WallpaperAspectStyle::Fit) {
-            mode = Qt::KeepAspectRatio;
-        }
-        QSize newSize = image.size();
-        newSize.scale(size, mode);
-        image = image.scaled(newSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-    }
-    static constexpr const QPoint desktopOriginPoint = {0, 0};
-    const QRect desktopRect = {desktopOriginPoint, size};
-    if (aspectStyle == WallpaperAspectStyle::Tile) {
+    {
         QPainter bufferPainter(&buffer);
         bufferPainter.setRenderHints(QPainter::Antialiasing |
             QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-        bufferPainter.fillRect(desktopRect, QBrush(image));
-    } else {
-        QPainter bufferPainter(&buffer);
-        bufferPainter.setRenderHints(QPainter::Antialiasing |
-            QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-        const QRect rect = alignedRect(Qt::LeftToRight, Qt::AlignCenter, image.size(), desktopRect);
-        bufferPainter.drawImage(rect.topLeft(), image);
+        // Everything is laid out in global device independent coordinates,
+        // the painter maps them to the pixels of this tile.
+        bufferPainter.scale(xScale, yScale);
+        bufferPainter.translate(-tileRect.topLeft());
+        if (aspectStyle == WallpaperAspectStyle::Tile) {
+            QBrush brush(image);
+            brush.setTransform(QTransform::fromScale(qreal(sourceSize.width()) / qreal(image.width()),
+                                                     qreal(sourceSize.height()) / qreal(image.height())));
+            bufferPainter.setBrushOrigin(layoutRect.topLeft());
+            bufferPainter.fillRect(layoutRect, brush);
+        } else {
+            // Already at the final pixel size, the painter only has to copy it.
+            bufferPainter.drawImage(targetRect, image);
+        }
     }
-    g_micaMaterialData()->mutex.lock();
-    QPainter painter(&g_micaMaterialData()->blurredWallpaper);
+    QPainter painter(&result);
     painter.setRenderHints(QPainter::Antialiasing |
         QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
+    MicaBlur::blurImage(&painter, buffer, (kDefaultBlurRadius * xScale), blurAlgorithm, blurQuality);
+    return result;
+}
+
+struct WallpaperCacheHeader
+{
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    qint64 bytesPerLine = 0;
+    qint32 format = 0;
+    qint32 reserved = 0;
+};
+static_assert(sizeof(WallpaperCacheHeader) == 32); // Keeps the pixel data 16-byte aligned.
+
+// The cache is shared by all applications of the current user, the blurred
+// wallpaper doesn't depend on anything application specific.
+[[nodiscard]] static inline QString wallpaperCacheDirPath()
+{
+    const QString cacheLocation = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    if (cacheLocation.isEmpty()) {
+        return {};
+    }
+    return QDir(cacheLocation).filePath(kWallpaperCacheDirName);
+}
+
+[[nodiscard]] static inline QString wallpaperCacheFilePath(const QString &wallpaperFilePath,
+    const WallpaperAspectStyle aspectStyle, const QRect &layoutRect, const QRect &tileRect, const QSize &bufferSize,
+    const MicaBlurAlgorithm blurAlgorithm, const MicaBlurQuality blurQuality)
+{
+    const QString dirPath = wallpaperCacheDirPath();
+    if (dirPath.isEmpty()) {
+        return {};
+    }
+    const QFileInfo fileInfo(wallpaperFilePath);
+    if (!fileInfo.exists()) {
+        return {};
+    }
+    const auto rectToByteArray = [](const QRect &rect) -> QByteArray {
+        return (QByteArray::number(rect.x()) + ',' + QByteArray::number(rect.y()) + ','
+            + QByteArray::number(rect.width()) + 'x' + QByteArray::number(rect.height()));
+    };
+    QByteArray key = {};
+    key += QFile::encodeName(fileInfo.absoluteFilePath());
+    key += '|' + QByteArray::number(fileInfo.lastModified().toMSecsSinceEpoch());
+    key += '|' + QByteArray::number(fileInfo.size());
+    key += '|' + QByteArray::number(static_cast<int>(aspectStyle));
+    key += '|' + rectToByteArray(layoutRect);
+    key += '|' + rectToByteArray(tileRect);
+    key += '|' + QByteArray::number(bufferSize.width()) + 'x' + QByteArray::number(bufferSize.height());
+    key += '|' + QByteArray::number(kDefaultBlurRadius);
+    key += '|' + QByteArray::number(static_cast<int>(blurAlgorithm));
+    key += '|' + QByteArray::number(static_cast<int>(blurQuality));
+    key += '|' + QByteArray::number(kWallpaperCacheVersion);
 #ifdef FRAMELESSHELPER_CORE_NO_PRIVATE
-    painter.drawImage(desktopOriginPoint, buffer);
-#else // !FRAMELESSHELPER_CORE_NO_PRIVATE
-    qt_blurImage(&painter, buffer, kDefaultBlurRadius, true, false);
+    key += "|noblur";
 #endif // FRAMELESSHELPER_CORE_NO_PRIVATE
-    g_micaMaterialData()->mutex.unlock();
-    Q_Q(MicaMaterial);
-    Q_EMIT q->shouldRedraw();
+    const QByteArray hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return QDir(dirPath).filePath(QString::fromLatin1(hash) + kWallpaperCacheFileSuffix);
+}
+
+static void releaseMappedWallpaperCache(void *info)
+{
+    delete static_cast<QFile *>(info);
+}
+
+// Remembers when a cache file was used last, the least recently used files are removed first.
+static inline void touchWallpaperCache(const QString &filePath)
+{
+    // Changing the file time needs write access (FILE_WRITE_ATTRIBUTES on Windows), which
+    // the read only handle of the mapping doesn't have. Append doesn't truncate the file.
+    QFile file(filePath);
+    if (!file.open(QFile::WriteOnly | QFile::Append)) {
+        WARNING << "Failed to open the wallpaper cache file for writing:" << filePath;
+        return;
+    }
+    if (!file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime)) {
+        WARNING << "Failed to update the modification time of the wallpaper cache file:" << filePath;
+    }
+}
+
+// The returned image points directly into the mapped file, nothing is decoded or copied.
+[[nodiscard]] static inline QImage loadWallpaperCache(const QString &filePath, const QSize &size)
+{
+    if (filePath.isEmpty() || !QFileInfo::exists(filePath)) {
+        return {};
+    }
+    auto file = new QFile(filePath);
+    if (!file->open(QFile::ReadOnly)) {
+        delete file;
+        return {};
+    }
+    const qint64 fileSize = file->size();
+    if (fileSize < qint64(sizeof(WallpaperCacheHeader))) {
+        delete file;
+        return {};
+    }
+    const uchar * const data = file->map(0, fileSize);
+    if (!data) {
+        delete file;
+        return {};
+    }
+    const auto header = reinterpret_cast<const WallpaperCacheHeader *>(data);
+    // The file may be corrupted, so the dimensions are validated before they are used in any
+    // arithmetic, the pixel data size is only derived once it can't overflow anymore.
+    const qint64 pixelDataSize = (fileSize - qint64(sizeof(WallpaperCacheHeader)));
+    const bool valid = ((header->magic == kWallpaperCacheMagic) && (header->version == kWallpaperCacheVersion)
+        && (header->format == QImage::Format_ARGB32_Premultiplied)
+        && (header->width > 0) && (header->height > 0)
+        && (header->width == size.width()) && (header->height == size.height())
+        && (header->bytesPerLine >= (qint64(header->width) * 4))
+        && (header->bytesPerLine <= (pixelDataSize / header->height))
+        && ((header->bytesPerLine * header->height) == pixelDataSize));
+    if (!valid) {
+        WARNING << "Ignoring invalid wallpaper cache file:" << filePath;
+        delete file;
+        return {};
+    }
+    touchWallpaperCache(filePath);
+    return QImage(data + sizeof(WallpaperCacheHeader), header->width, header->height,
+        header->bytesPerLine, QImage::Format_ARGB32_Premultiplied, releaseMappedWallpaperCache, file);
+}
+
+static inline void trimWallpaperCache(const QString &dirPath)
+{
+    QDir dir(dirPath);
+    const QFileInfoList entries = dir.entryInfoList({kWallpaperCacheFileFilter},
+        QDir::Files, (QDir::Time | QDir::Reversed));
+    qint64 totalSize = 0;
+    for (auto &&entry : std::as_const(entries)) {
+        totalSize += entry.size();
+    }
+    // Oldest first, and the newest one is always kept.
+    qsizetype count = entries.size();
+    for (qsizetype i = 0; i < (entries.size() - 1); ++i) {
+        if ((count <= kWallpaperCacheMaxFileCount) && (totalSize <= kWallpaperCacheMaxTotalSize)) {
+            break;
+        }
+        const QFileInfo &entry = entries.at(i);
+        if (QFile::remove(entry.absoluteFilePath())) {
+            totalSize -= entry.size();
+            --count;
+        }
+    }
+}
+
+static inline void saveWallpaperCache(const QString &filePath, const QImage &image)
+{
+    if (filePath.isEmpty() || image.isNull() || (image.format() != QImage::Format_ARGB32_Premultiplied)) {
+        return;
+    }
+    const QString dirPath = QFileInfo(filePath).absolutePath();
+    if (!QDir().mkpath(dirPath)) {
+        WARNING << "Failed to create the wallpaper cache directory:" << dirPath;
+        return;
+    }
+    WallpaperCacheHeader header = {};
+    header.magic = kWallpaperCacheMagic;
+    header.version = kWallpaperCacheVersion;
+    header.width = image.width();
+    header.height = image.height();
+    header.bytesPerLine = image.bytesPerLine();
+    header.format = image.format();
+    // Other processes may be reading the old file at the same time, so never write in place.
+    QSaveFile file(filePath);
+    if (!file.open(QFile::WriteOnly)) {
+        WARNING << "Failed to create the wallpaper cache file:" << filePath;
+        return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(image.constBits()), (header.bytesPerLine * header.height));
+    if (!file.commit()) {
+        WARNING << "Failed to write the wallpaper cache file:" << filePath;
+        return;
+    }
+    trimWallpaperCache(dirPath);
+}
+
+void MicaMaterialPrivate::maybeGenerateBlurredWallpaper(const bool force)
+{
+    if (force) {
+        regenerateWallpaperTiles();
+        return;
+    }
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    for (auto &&screen : std::as_const(screens)) {
+        maybeGenerateWallpaperTile(screen);
+    }
+}
+
+void MicaMaterialPrivate::regenerateWallpaperTiles()
+{
+    // The wallpaper (or the way it's blurred) has changed, every existing tile is outdated
+    // now. The screens that don't have a tile yet will get one once they show some mica.
+    QList<QScreen *> screens = {};
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        ++g_micaMaterialData()->wallpaperGeneration;
+        screens = g_micaMaterialData()->wallpaperTiles.keys();
+    }
+    for (auto &&screen : std::as_const(screens)) {
+        maybeGenerateWallpaperTile(screen);
+    }
+}
+
+void MicaMaterialPrivate::maybeGenerateWallpaperTile(QScreen *screen)
+{
+    Q_ASSERT(screen);
+    if (!screen) {
+        return;
+    }
+    const QRect geometry = screen->geometry();
+    const int scale = (FramelessConfig::instance()->isSet(Option::DisableDownscalingForMicaMaterial)
+        ? 1 : kWallpaperDownscaleFactor);
+    const QSize tileSize = wallpaperTileSize(geometry, screen->devicePixelRatio(), scale);
+    quint64 request = 0;
+    MicaBlurAlgorithm blurAlgorithm = MicaBlurAlgorithm::Exponential;
+    MicaBlurQuality blurQuality = MicaBlurQuality::Balanced;
+    // The current tile, if it's still of the current generation.
+    QImage currentImage = {};
+    QRect currentGeometry = {};
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        MicaMaterialData::WallpaperTile &tile = g_micaMaterialData()->wallpaperTiles[screen];
+        const quint64 generation = g_micaMaterialData()->wallpaperGeneration;
+        if ((tile.generation == generation) && (tile.geometry == geometry) && (tile.image.size() == tileSize)) {
+            // Drop any request that is still running, the screen went back to what it was.
+            tile.pendingRequest = 0;
+            return;
+        }
+        if ((tile.pendingRequest != 0) && (tile.pendingGeneration == generation)
+            && (tile.pendingGeometry == geometry) && (tile.pendingSize == tileSize)) {
+            return;
+        }
+        request = ++g_micaMaterialData()->lastWallpaperRequest;
+        tile.pendingRequest = request;
+        tile.pendingGeneration = generation;
+        tile.pendingGeometry = geometry;
+        tile.pendingSize = tileSize;
+        blurAlgorithm = g_micaMaterialData()->blurAlgorithm;
+        blurQuality = g_micaMaterialData()->blurQuality;
+        if (tile.generation == generation) {
+            currentImage = tile.image;
+            currentGeometry = tile.geometry;
+        }
+    }
+    const QString wallpaperFilePath = Utils::getWallpaperFilePath();
+    if (wallpaperFilePath.isEmpty()) {
+        WARNING << "Failed to retrieve the wallpaper file path.";
+    }
+    const WallpaperAspectStyle aspectStyle = Utils::getWallpaperAspectStyle();
+    const QRect layoutRect = ((aspectStyle == WallpaperAspectStyle::Span) ? screen->virtualGeometry() : geometry);
+    // If only the scale factor of the screen has changed (the window was moved to a screen
+    // with a different DPR, or the user changed the scaling) and the wallpaper still covers
+    // the screen the same way, the current tile can simply be scaled to the new size: it's
+    // nothing but a heavy blur, so that looks the same as generating it again, at a tiny
+    // fraction of the cost. The wallpaper is only decoded again when it has changed.
+    QImage resampleSource = {};
+    if (!currentImage.isNull() && !wallpaperFilePath.isEmpty()) {
+        const bool sameLayout = ((currentGeometry == geometry) || ((aspectStyle != WallpaperAspectStyle::Span)
+            && (qAbs((qint64(currentGeometry.width()) * geometry.height()) - (qint64(currentGeometry.height()) * geometry.width()))
+                <= qMax(geometry.width(), geometry.height()))));
+        if (sameLayout) {
+            resampleSource = currentImage;
+        }
+    }
+    // Decoding, scaling and blurring a screen sized image takes quite some time, so it
+    // is done in the background. Until it has finished, paint() draws a plain placeholder
+    // (or the previous tile, if there is one), and all instances are asked to redraw
+    // once the new one is ready. The screen is only used as a key from now on, it's
+    // never dereferenced outside of the GUI thread.
+    QThreadPool::globalInstance()->start(new MicaMaterialTask([screen, request, wallpaperFilePath, aspectStyle,
+            layoutRect, geometry, tileSize, blurAlgorithm, blurQuality, resampleSource]() -> void {
+        g_micaMaterialData()->mutex.lock();
+        const auto it = std::as_const(g_micaMaterialData()->wallpaperTiles).find(screen);
+        const bool outdated = ((it == g_micaMaterialData()->wallpaperTiles.cend()) || (it->pendingRequest != request));
+        g_micaMaterialData()->mutex.unlock();
+        if (outdated) {
+            // The screen is gone, or someone has asked for a newer tile in the mean time.
+            return;
+        }
+        if (wallpaperFilePath.isEmpty()) {
+            QImage image(tileSize, QImage::Format_ARGB32_Premultiplied);
+            image.fill(kDefaultTransparentColor);
+            publishWallpaperTile(screen, request, image);
+            return;
+        }
+        // A warm start only has to map the result of a previous run.
+        const QString cacheFilePath = wallpaperCacheFilePath(wallpaperFilePath, aspectStyle,
+            layoutRect, geometry, tileSize, blurAlgorithm, blurQuality);
+        const QImage cachedImage = loadWallpaperCache(cacheFilePath, tileSize);
+        if (!cachedImage.isNull()) {
+            DEBUG << "Using the cached blurred wallpaper:" << cacheFilePath;
+            publishWallpaperTile(screen, request, cachedImage);
+            return;
+        }
+        if (!resampleSource.isNull()) {
+            // Not saved to the disk cache, a real one will be generated next time.
+            publishWallpaperTile(screen, request, resampleSource.scaled(tileSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+            return;
+        }
+        const QImage image = generateBlurredWallpaper(wallpaperFilePath, aspectStyle,
+            layoutRect, geometry, tileSize, blurAlgorithm, blurQuality);
+        publishWallpaperTile(screen, request, image);
+        saveWallpaperCache(cacheFilePath, image);
+    }));
+}
+
+void MicaMaterialPrivate::publishWallpaperTile(QScreen *screen, const quint64 request, const QImage &image)
+{
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    const auto it = g_micaMaterialData()->wallpaperTiles.find(screen);
+    if ((it == g_micaMaterialData()->wallpaperTiles.end()) || (it->pendingRequest != request)) {
+        return;
+    }
+    it->image = image;
+    it->geometry = it->pendingGeometry;
+    it->generation = it->pendingGeneration;
+    it->request = request;
+    it->pendingRequest = 0;
+    // The instances can live in any thread (the Qt Quick ones live in the render thread),
+    // so we let each of them emit the signal in its own thread. An instance can't be
+    // destroyed while we are holding the lock, and Qt drops the posted call if it gets
+    // destroyed before the call is delivered.
+    for (auto &&instance : std::as_const(g_micaMaterialData()->instances)) {
+        QMetaObject::invokeMethod(instance, [instance]() -> void {
+            Q_EMIT instance->q_ptr->shouldRedraw();
+        }, Qt::QueuedConnection);
+    }
 }
 
 void MicaMaterialPrivate::updateMaterialBrush()
@@ -589,53 +713,267 @@ void MicaMaterialPrivate::updateMaterialBrush()
     initResource();
     static const QImage noiseTexture = QImage(kNoiseImageFilePath);
 #endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
-    QImage micaTexture = QImage(QSize(64, 64), QImage::Format_ARGB32_Premultiplied);
     QColor fillColor = (Utils::shouldAppsUseDarkMode() ? kDefaultSystemDarkColor : kDefaultSystemLightColor2);
+    placeholderColor = fillColor;
     fillColor.setAlphaF(0.9f);
-    micaTexture.fill(fillColor);
+    // The tint is the same everywhere, so one pixel of it is enough.
+    QImage tintTexture = QImage(QSize(1, 1), QImage::Format_ARGB32_Premultiplied);
+    tintTexture.fill(fillColor);
+    {
+        QPainter painter(&tintTexture);
+        painter.setOpacity(tintOpacity);
+        painter.fillRect(QRect(0, 0, 1, 1), tintColor);
+    }
+    const QColor oldMaterialColor = materialColor;
+    materialColor = tintTexture.pixelColor(0, 0);
+    QImage micaTexture = QImage(QSize(64, 64), QImage::Format_ARGB32_Premultiplied);
+    micaTexture.fill(materialColor);
     QPainter painter(&micaTexture);
     painter.setRenderHints(QPainter::Antialiasing |
         QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-    painter.setOpacity(tintOpacity);
-    const QRect rect = {QPoint(0, 0), micaTexture.size()};
-    painter.fillRect(rect, tintColor);
     painter.setOpacity(noiseOpacity);
 #ifndef FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
+    const QRect rect = {QPoint(0, 0), micaTexture.size()};
     painter.fillRect(rect, QBrush(noiseTexture));
+    noiseBrush = QBrush(noiseTexture);
 #endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
     micaBrush = QBrush(micaTexture);
+    // The tint is baked into the surfaces, the noise is not.
+    if (materialColor != oldMaterialColor) {
+        surfaces.clear();
+    }
     if (initialized) {
         Q_Q(MicaMaterial);
         Q_EMIT q->shouldRedraw();
     }
 }
 
-void MicaMaterialPrivate::paint(QPainter *painter, const QSize &size, const QPoint &pos)
+std::shared_ptr<const QImage> MicaMaterialPrivate::surfaceForScreen(QScreen *screen, const QImage &tile, const quint64 tileRequest)
+{
+    Q_ASSERT(screen);
+    Q_ASSERT(!tile.isNull());
+    if (!screen || tile.isNull()) {
+        return nullptr;
+    }
+    const auto it = std::as_const(surfaces).find(screen);
+    if ((it != surfaces.cend()) && (it->tileRequest == tileRequest)) {
+        return it->image;
+    }
+    // The instances that would bake exactly the same pixels share one surface.
+    const auto findSharedSurface = [&]() -> std::shared_ptr<const QImage> {
+        // The caller must hold the lock.
+        for (auto &&shared : std::as_const(g_micaMaterialData()->surfaces)) {
+            if ((shared.screen == screen) && (shared.tileRequest == tileRequest)
+                && (shared.placeholderColor == placeholderColor) && (shared.materialColor == materialColor)) {
+                return shared.image.lock();
+            }
+        }
+        return nullptr;
+    };
+    std::shared_ptr<const QImage> surface = nullptr;
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        surface = findSharedSurface();
+    }
+    if (!surface) {
+        // Blending the tint over the tile only has to be done once. The surface keeps the
+        // resolution of the tile, which is a fraction of the screen's, so it's as small as
+        // the tile itself, and it's opaque, so painting it is a plain scaled copy.
+        QImage image(tile.size(), QImage::Format_RGB32);
+        image.fill(placeholderColor);
+        {
+            QPainter painter(&image);
+            painter.drawImage(QPoint(0, 0), tile);
+            painter.fillRect(image.rect(), materialColor);
+        }
+        // Baked without the lock, if another instance has been faster, its surface is used.
+        auto baked = std::make_shared<const QImage>(std::move(image));
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        pruneSharedSurfaces();
+        surface = findSharedSurface();
+        if (!surface) {
+            MicaMaterialData::SharedSurface shared = {};
+            shared.screen = screen;
+            shared.tileRequest = tileRequest;
+            shared.placeholderColor = placeholderColor;
+            shared.materialColor = materialColor;
+            shared.image = baked;
+            g_micaMaterialData()->surfaces.append(shared);
+            surface = std::move(baked);
+        }
+    }
+    MicaSurface &entry = surfaces[screen];
+    entry.image = surface;
+    entry.tileRequest = tileRequest;
+    return surface;
+}
+
+void MicaMaterialPrivate::paint(QPainter *painter, const QSize &size, const QPoint &pos, const QRegion &exposedRegion)
 {
     Q_ASSERT(painter);
-    if (!painter) {
+    if (!painter || exposedRegion.isEmpty()) {
         return;
     }
-    prepareGraphicsResources();
-    static constexpr const QPoint originPoint = {0, 0};
+    setActive(true);
+    const QRect globalRect = QRect(pos, size).intersected(exposedRegion.boundingRect().translated(pos));
     painter->save();
-    painter->setRenderHints(QPainter::Antialiasing |
-        QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
-    g_micaMaterialData()->mutex.lock();
-    painter->drawPixmap(originPoint, g_micaMaterialData()->blurredWallpaper, QRect(pos, size));
-    g_micaMaterialData()->mutex.unlock();
+    painter->setRenderHint(QPainter::Antialiasing, false);
+    // The surfaces have the resolution of the tiles, they are scaled up with bilinear filtering.
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, true);
     painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
     painter->setOpacity(1.0);
-    painter->fillRect(QRect(originPoint, size), micaBrush);
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    for (auto it = surfaces.begin(); it != surfaces.end();) {
+        if (screens.contains(it.key())) {
+            ++it;
+        } else {
+            it = surfaces.erase(it);
+        }
+    }
+    for (auto &&screen : std::as_const(screens)) {
+        const QRect screenRect = globalRect.intersected(screen->geometry());
+        if (screenRect.isEmpty()) {
+            continue;
+        }
+        // Only the screens that actually show some mica get a tile.
+        maybeGenerateWallpaperTile(screen);
+        g_micaMaterialData()->mutex.lock();
+        const MicaMaterialData::WallpaperTile &tile = g_micaMaterialData()->wallpaperTiles[screen];
+        const QImage wallpaper = tile.image;
+        const QRect tileGeometry = tile.geometry;
+        const quint64 tileRequest = tile.request;
+        g_micaMaterialData()->mutex.unlock();
+        // Only the exposed parts are copied, small repaints stay small.
+        const QRegion targetRegion = exposedRegion.intersected(screenRect.translated(-pos));
+        if (wallpaper.isNull()) {
+            // Still being generated, we'll be asked to redraw once it's ready.
+            for (auto &&targetRect : targetRegion) {
+                painter->fillRect(targetRect, placeholderColor);
+                painter->fillRect(targetRect, micaBrush);
+            }
+            continue;
+        }
+        // The tile may still be the one of the previous screen geometry, until the new one is ready.
+        const std::shared_ptr<const QImage> surface = surfaceForScreen(screen, wallpaper, tileRequest);
+        if (!surface) {
+            continue;
+        }
+        // One scaled copy for the whole screen, clipped to the exposed region, so that the
+        // rectangles of the region can't leave any seams between each other.
+        const QRect targetRect = targetRegion.boundingRect();
+        const qreal xScale = (qreal(surface->width()) / qreal(tileGeometry.width()));
+        const qreal yScale = (qreal(surface->height()) / qreal(tileGeometry.height()));
+        const QPoint offset = (targetRect.topLeft() + pos - tileGeometry.topLeft());
+        const QRectF sourceRect = {(offset.x() * xScale), (offset.y() * yScale),
+            (targetRect.width() * xScale), (targetRect.height() * yScale)};
+        painter->save();
+        painter->setClipRegion(targetRegion, Qt::IntersectClip);
+        // The surface is opaque, it replaces whatever is below it.
+        painter->setCompositionMode(QPainter::CompositionMode_Source);
+        painter->drawImage(QRectF(targetRect), *surface, sourceRect);
+        // The noise would be smeared by the scaling, so it's blended over the surface
+        // afterwards, laid out from the top left corner of the screen.
+        painter->setCompositionMode(QPainter::CompositionMode_SourceOver);
+        painter->setOpacity(noiseOpacity);
+        painter->setBrushOrigin(tileGeometry.topLeft() - pos);
+        painter->fillRect(targetRect, noiseBrush);
+        painter->restore();
+    }
     painter->restore();
 }
 
+void MicaMaterialPrivate::setActive(const bool value)
+{
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        if (active == value) {
+            return;
+        }
+        active = value;
+        if (value) {
+            ++g_micaMaterialData()->idleToken;
+            return;
+        }
+    }
+    // Nothing of it is needed any more, the surfaces are rebuilt when we paint again.
+    surfaces.clear();
+    scheduleIdleRelease();
+}
+
+bool MicaMaterialPrivate::isAnyInstanceActive()
+{
+    // The caller must hold the lock.
+    for (auto &&instance : std::as_const(g_micaMaterialData()->instances)) {
+        if (instance->active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MicaMaterialPrivate::scheduleIdleRelease()
+{
+    quint64 token = 0;
+    int timeout = 0;
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        if (isAnyInstanceActive() || (g_micaMaterialData()->cacheIdleTimeout < 0)) {
+            return;
+        }
+        token = ++g_micaMaterialData()->idleToken;
+        timeout = g_micaMaterialData()->cacheIdleTimeout;
+    }
+    QCoreApplication * const app = QCoreApplication::instance();
+    if (!app) {
+        return;
+    }
+    // Instances can live in threads without an event loop, so the timer runs in the main thread.
+    QMetaObject::invokeMethod(app, [app, token, timeout]() -> void {
+        QTimer::singleShot(timeout, app, [token]() -> void {
+            const QMutexLocker locker(&g_micaMaterialData()->mutex);
+            if ((token != g_micaMaterialData()->idleToken) || isAnyInstanceActive()) {
+                return;
+            }
+            // The tiles are regenerated (usually straight from the disk cache) on next use.
+            DEBUG << "Releasing the blurred wallpaper, no mica material has been painted for a while.";
+            g_micaMaterialData()->wallpaperTiles.clear();
+        });
+    }, Qt::QueuedConnection);
+}
+
+void MicaMaterialPrivate::trimCaches(const CacheTrimLevel level)
+{
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    if (level == CacheTrimLevel::Unused) {
+        if (!isAnyInstanceActive()) {
+            g_micaMaterialData()->wallpaperTiles.clear();
+        }
+    } else {
+        // Requests that are still running find their tile gone and throw their results away.
+        g_micaMaterialData()->wallpaperTiles.clear();
+    }
+    // The surfaces belong to the threads of their instances. Windows keep showing what
+    // they have painted before, everything is regenerated once they repaint.
+    for (auto &&instance : std::as_const(g_micaMaterialData()->instances)) {
+        QMetaObject::invokeMethod(instance, [instance, level]() -> void {
+            if (level == CacheTrimLevel::All) {
+                instance->surfaces.clear();
+            }
+            Q_EMIT instance->cachesTrimmed(level);
+        }, Qt::QueuedConnection);
+    }
+}
+
 void MicaMaterialPrivate::initialize()
 {
     tintColor = kDefaultTransparentColor;
     tintOpacity = kDefaultTintOpacity;
     noiseOpacity = kDefaultNoiseOpacity;
 
+    g_micaMaterialData()->mutex.lock();
+    g_micaMaterialData()->instances.append(this);
+    g_micaMaterialData()->mutex.unlock();
+
     updateMaterialBrush();
 
     connect(FramelessManager::instance(), &FramelessManager::systemThemeChanged,
@@ -645,25 +983,24 @@ void MicaMaterialPrivate::initialize()
             maybeGenerateBlurredWallpaper(true);
         });
 
+    // The tile of a screen that has been unplugged is never needed again.
+    static const bool screenRemovalTracked = []() -> bool {
+        connect(qGuiApp, &QGuiApplication::screenRemoved, qGuiApp, [](QScreen *screen){
+            const QMutexLocker locker(&g_micaMaterialData()->mutex);
+            g_micaMaterialData()->wallpaperTiles.remove(screen);
+        });
+        return true;
+    }();
+    Q_UNUSED(screenRemovalTracked);
+
     if (FramelessConfig::instance()->isSet(Option::DisableLazyInitializationForMicaMaterial)) {
-        prepareGraphicsResources();
+        // Generate the tiles of all screens up front, instead of waiting for the first paint.
+        maybeGenerateBlurredWallpaper();
     }
 
     initialized = true;
 }
 
-void MicaMaterialPrivate::prepareGraphicsResources()
-{
-    g_micaMaterialData()->mutex.lock();
-    if (g_micaMaterialData()->graphicsResourcesReady) {
-        g_micaMaterialData()->mutex.unlock();
-        return;
-    }
-    g_micaMaterialData()->graphicsResourcesReady = true;
-    g_micaMaterialData()->mutex.unlock();
-    maybeGenerateBlurredWallpaper();
-}
-
 MicaMaterial::MicaMaterial(QObject *parent)
     : QObject(parent), d_ptr(new MicaMaterialPrivate(this))
 {
@@ -687,7 +1024,6 @@ void MicaMaterial::setTintColor(const QColor &value)
     if (d->tintColor == value) {
         return;
     }
-    d->prepareGraphicsResources();
     d->tintColor = value;
     d->updateMaterialBrush();
     Q_EMIT tintColorChanged();
@@ -705,7 +1041,6 @@ void MicaMaterial::setTintOpacity(const qreal value)
     if (qFuzzyCompare(d->tintOpacity, value)) {
         return;
     }
-    d->prepareGraphicsResources();
     d->tintOpacity = value;
     d->updateMaterialBrush();
     Q_EMIT tintOpacityChanged();
@@ -723,7 +1058,6 @@ void MicaMaterial::setNoiseOpacity(const qreal value)
     if (qFuzzyCompare(d->noiseOpacity, value)) {
         return;
     }
-    d->prepareGraphicsResources();
     d->noiseOpacity = value;
     d->updateMaterialBrush();
     Q_EMIT noiseOpacityChanged();
@@ -732,7 +1066,73 @@ void MicaMaterial::setNoiseOpacity(const qreal value)
 void MicaMaterial::paint(QPainter *painter, const QSize &size, const QPoint &pos)
 {
     Q_D(MicaMaterial);
-    d->paint(painter, size, pos);
+    d->paint(painter, size, pos, QRegion(QRect(QPoint(0, 0), size)));
+}
+
+void MicaMaterial::paintRegion(QPainter *painter, const QSize &size, const QPoint &pos, const QRegion &exposedRegion)
+{
+    Q_D(MicaMaterial);
+    d->paint(painter, size, pos, exposedRegion);
+}
+
+int MicaMaterial::blurThreadCount()
+{
+    return MicaBlur::threadPool()->maxThreadCount();
+}
+
+void MicaMaterial::setBlurThreadCount(const int count)
+{
+    MicaBlur::threadPool()->setMaxThreadCount((count > 0) ? count : QThread::idealThreadCount());
+}
+
+int MicaMaterial::cacheIdleTimeout()
+{
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    return g_micaMaterialData()->cacheIdleTimeout;
+}
+
+void MicaMaterial::setCacheIdleTimeout(const int timeout)
+{
+    g_micaMaterialData()->mutex.lock();
+    g_micaMaterialData()->cacheIdleTimeout = timeout;
+    g_micaMaterialData()->mutex.unlock();
+    MicaMaterialPrivate::scheduleIdleRelease();
+}
+
+MicaBlurAlgorithm MicaMaterial::blurAlgorithm()
+{
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    return g_micaMaterialData()->blurAlgorithm;
+}
+
+void MicaMaterial::setBlurAlgorithm(const MicaBlurAlgorithm algorithm)
+{
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        if (g_micaMaterialData()->blurAlgorithm == algorithm) {
+            return;
+        }
+        g_micaMaterialData()->blurAlgorithm = algorithm;
+    }
+    MicaMaterialPrivate::regenerateWallpaperTiles();
+}
+
+MicaBlurQuality MicaMaterial::blurQuality()
+{
+    const QMutexLocker locker(&g_micaMaterialData()->mutex);
+    return g_micaMaterialData()->blurQuality;
+}
+
+void MicaMaterial::setBlurQuality(const MicaBlurQuality quality)
+{
+    {
+        const QMutexLocker locker(&g_micaMaterialData()->mutex);
+        if (g_micaMaterialData()->blurQuality == quality) {
+            return;
+        }
+        g_micaMaterialData()->blurQuality = quality;
+    }
+    MicaMaterialPrivate::regenerateWallpaperTiles();
 }
 
 FRAMELESSHELPER_END_NAMESPACE
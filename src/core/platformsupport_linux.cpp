@@ -34,6 +34,7 @@ FRAMELESSHELPER_STRING_CONSTANT(xcb_intern_atom_reply)
 FRAMELESSHELPER_STRING_CONSTANT(xcb_ungrab_pointer)
 FRAMELESSHELPER_STRING_CONSTANT(xcb_change_property)
 FRAMELESSHELPER_STRING_CONSTANT(xcb_delete_property_checked)
+FRAMELESSHELPER_STRING_CONSTANT(xcb_delete_property)
 FRAMELESSHELPER_STRING_CONSTANT(xcb_get_property)
 FRAMELESSHELPER_STRING_CONSTANT(xcb_get_property_reply)
 FRAMELESSHELPER_STRING_CONSTANT(xcb_get_property_value)
@@ -144,6 +145,19 @@ xcb_delete_property_checked(
     return API_CALL_FUNCTION(xcb_delete_property_checked, connection, window, property);
 }
 
+extern "C" xcb_void_cookie_t
+xcb_delete_property(
+    xcb_connection_t *connection,
+    xcb_window_t window,
+    xcb_atom_t property
+)
+{
+    if (!API_XCB_AVAILABLE(xcb_delete_property)) {
+        return {};
+    }
+    return API_CALL_FUNCTION(xcb_delete_property, connection, window, property);
+}
+
 extern "C" xcb_get_property_cookie_t
 xcb_get_property(
     xcb_connection_t *connection,
@@ -75,40 +75,46 @@ static const QHash<int, FONT_ICON> g_fontIconsTable = {
 };
 #endif // FRAMELESSHELPER_CORE_NO_BUNDLE_RESOURCE
 
-Qt::CursorShape Utils::calculateCursorShape(const QWindow *window, const QPoint &pos)
+static inline Qt::Edges calculateEdges(const QSize &size, const QPoint &pos)
 {
-#ifdef Q_OS_MACOS
-    Q_UNUSED(window);
-    Q_UNUSED(pos);
-    return Qt::ArrowCursor;
-#else
-    Q_ASSERT(window);
-    if (!window) {
-        return Qt::ArrowCursor;
-    }
-    if (window->visibility() != QWindow::Windowed) {
-        return Qt::ArrowCursor;
-    }
+    Qt::Edges edges = {};
     const int x = pos.x();
     const int y = pos.y();
-    const int w = window->width();
-    const int h = window->height();
-    if (((x < kDefaultResizeBorderThickness) && (y < kDefaultResizeBorderThickness))
-        || ((x >= (w - kDefaultResizeBorderThickness)) && (y >= (h - kDefaultResizeBorderThickness)))) {
+    if (x < kDefaultResizeBorderThickness) {
+        edges |= Qt::LeftEdge;
+    }
+    if (x >= (size.width() - kDefaultResizeBorderThickness)) {
+        edges |= Qt::RightEdge;
+    }
+    if (y < kDefaultResizeBorderThickness) {
+        edges |= Qt::TopEdge;
+    }
+    if (y >= (size.height() - kDefaultResizeBorderThickness)) {
+        edges |= Qt::BottomEdge;
+    }
+    return edges;
+}
+
+Qt::CursorShape Utils::calculateCursorShape(const QWindow *window, const QPoint &pos)
+{
+    return calculateCursorShape(calculateWindowEdges(window, pos));
+}
+
+Qt::CursorShape Utils::calculateCursorShape(const Qt::Edges edges)
+{
+    if ((edges == (Qt::LeftEdge | Qt::TopEdge)) || (edges == (Qt::RightEdge | Qt::BottomEdge))) {
         return Qt::SizeFDiagCursor;
     }
-    if (((x >= (w - kDefaultResizeBorderThickness)) && (y < kDefaultResizeBorderThickness))
-        || ((x < kDefaultResizeBorderThickness) && (y >= (h - kDefaultResizeBorderThickness)))) {
+    if ((edges == (Qt::RightEdge | Qt::TopEdge)) || (edges == (Qt::LeftEdge | Qt::BottomEdge))) {
         return Qt::SizeBDiagCursor;
     }
-    if ((x < kDefaultResizeBorderThickness) || (x >= (w - kDefaultResizeBorderThickness))) {
+    if (edges & (Qt::LeftEdge | Qt::RightEdge)) {
         return Qt::SizeHorCursor;
     }
-    if ((y < kDefaultResizeBorderThickness) || (y >= (h - kDefaultResizeBorderThickness))) {
+    if (edges & (Qt::TopEdge | Qt::BottomEdge)) {
         return Qt::SizeVerCursor;
     }
     return Qt::ArrowCursor;
-#endif
 }
 
 Qt::Edges Utils::calculateWindowEdges(const QWindow *window, const QPoint &pos)
@@ -125,23 +131,49 @@ Qt::Edges Utils::calculateWindowEdges(const QWindow *window, const QPoint &pos)
     if (window->visibility() != QWindow::Windowed) {
         return {};
     }
-    Qt::Edges edges = {};
-    const int x = pos.x();
-    const int y = pos.y();
-    if (x < kDefaultResizeBorderThickness) {
-        edges |= Qt::LeftEdge;
+    return calculateEdges(window->size(), pos);
+#endif
+}
+
+HitTestResult Utils::classifyHitTestZone(const HitTestGeometry &geometry, const QPoint &pos, const bool resizable)
+{
+    HitTestResult result = {};
+#ifdef Q_OS_MACOS
+    // The window is still resized by the system on macOS, but we must not treat its
+    // frame border as a part of the title bar, otherwise a press there would start
+    // a system move which competes with the native resize.
+    if (resizable && (calculateEdges(geometry.windowSize, pos) & (Qt::LeftEdge | Qt::RightEdge | Qt::TopEdge))) {
+        result.zone = HitTestZone::FrameBorder;
+        return result;
     }
-    if (x >= (window->width() - kDefaultResizeBorderThickness)) {
-        edges |= Qt::RightEdge;
+#else
+    if (resizable) {
+        result.edges = calculateEdges(geometry.windowSize, pos);
+        if (result.edges != Qt::Edges{}) {
+            result.zone = HitTestZone::ResizeBorder;
+            return result;
+        }
     }
-    if (y < kDefaultResizeBorderThickness) {
-        edges |= Qt::TopEdge;
+#endif
+    // System buttons don't need to be placed inside the title bar.
+    for (auto &&button : std::as_const(geometry.systemButtons)) {
+        if (button.second.contains(pos)) {
+            result.zone = HitTestZone::SystemButton;
+            result.button = button.first;
+            return result;
+        }
     }
-    if (y >= (window->height() - kDefaultResizeBorderThickness)) {
-        edges |= Qt::BottomEdge;
+    if (!geometry.titleBarRect.contains(pos)) {
+        return result;
     }
-    return edges;
-#endif
+    for (auto &&rect : std::as_const(geometry.hitTestVisibleRects)) {
+        if (rect.contains(pos)) {
+            result.zone = HitTestZone::HitTestVisible;
+            return result;
+        }
+    }
+    result.zone = HitTestZone::Caption;
+    return result;
 }
 
 QString Utils::getSystemButtonIconCode(const SystemButtonType button)
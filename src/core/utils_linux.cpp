@@ -26,7 +26,15 @@
 #include "framelessconfig_p.h"
 #include "framelessmanager.h"
 #include "framelessmanager_p.h"
+#include "x11requestbatch_p.h"
 #include <cstring> // for std::memcpy
+#include <atomic>
+#include <QtCore/qmutex.h>
+#include <QtCore/qset.h>
+#include <QtCore/qabstractnativeeventfilter.h>
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qsettings.h>
+#include <QtCore/qstandardpaths.h>
 #include <QtGui/qwindow.h>
 #include <QtGui/qscreen.h>
 #include <QtGui/qguiapplication.h>
@@ -45,9 +53,17 @@
 #    include <QtPlatformHeaders/qxcbscreenfunctions.h>
 #  endif // (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
 #endif // FRAMELESSHELPER_CORE_NO_PRIVATE
+#ifdef FRAMELESSHELPER_CORE_HAS_DBUS
+#  include <QtDBus/qdbusconnection.h>
+#  include <QtDBus/qdbusmessage.h>
+#  include <QtDBus/qdbusargument.h>
+#  include <QtDBus/qdbusextratypes.h>
+#endif // FRAMELESSHELPER_CORE_HAS_DBUS
 
+#ifndef FRAMELESSHELPER_CORE_NO_GTK
 extern template bool gtkSettings<bool>(const gchar *);
 extern QString gtkSettings(const gchar *);
+#endif // FRAMELESSHELPER_CORE_NO_GTK
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
@@ -81,6 +97,49 @@ FRAMELESSHELPER_BYTEARRAY_CONSTANT(connection)
 static constexpr const auto _XCB_SEND_EVENT_MASK =
     (XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY);
 
+static constexpr const int kX11AtomCount = static_cast<int>(X11Atom::Count);
+
+// Indexed by X11Atom.
+static constexpr const char *kX11AtomNames[] = {
+    ATOM_NET_SUPPORTED,
+    ATOM_NET_WM_NAME,
+    ATOM_NET_WM_MOVERESIZE,
+    ATOM_NET_SUPPORTING_WM_CHECK,
+    ATOM_NET_KDE_COMPOSITE_TOGGLING,
+    ATOM_KDE_NET_WM_BLUR_BEHIND_REGION,
+    ATOM_GTK_SHOW_WINDOW_MENU,
+    ATOM_DEEPIN_NO_TITLEBAR,
+    ATOM_DEEPIN_FORCE_DECORATE,
+    ATOM_NET_WM_DEEPIN_BLUR_REGION_MASK,
+    ATOM_NET_WM_DEEPIN_BLUR_REGION_ROUNDED,
+    ATOM_UTF8_STRING
+};
+static_assert((sizeof(kX11AtomNames) / sizeof(kX11AtomNames[0])) == kX11AtomCount);
+
+struct X11AtomData
+{
+    QMutex mutex;
+    std::atomic_bool initialized = false;
+    xcb_atom_t atoms[kX11AtomCount] = {};
+};
+
+Q_GLOBAL_STATIC(X11AtomData, g_x11AtomData)
+
+// What the window manager supports. Each part is queried when it's first needed and
+// thrown away again when the root window says it has changed, see X11RootWindowWatcher.
+struct X11WindowManagerData
+{
+    QMutex mutex;
+    bool nameValid = false;
+    QString name = {};
+    bool supportedAtomsValid = false;
+    QSet<xcb_atom_t> supportedAtoms = {};
+    bool rootWindowPropertiesValid = false;
+    QSet<xcb_atom_t> rootWindowProperties = {};
+};
+
+Q_GLOBAL_STATIC(X11WindowManagerData, g_x11WindowManagerData)
+
 [[maybe_unused]] [[nodiscard]] static inline int
     qtEdgesToWmMoveOrResizeOperation(const Qt::Edges edges)
 {
@@ -390,8 +449,8 @@ bool Utils::isTitleBarColorized()
 
 QColor Utils::getWmThemeColor()
 {
-    // ### TODO
-    return {};
+    // Only the XDG desktop portal knows about an accent color, GTK3 doesn't have one.
+    return FramelessManagerPrivate::desktopAccentColor();
 }
 
 bool Utils::shouldAppsUseDarkMode_linux()
@@ -409,32 +468,158 @@ bool Utils::shouldAppsUseDarkMode_linux()
         it's mainly used for easy debugging, so it should be possible to use it
         to override any other settings.
     */
-    const QString envThemeName = qEnvironmentVariable(GTK_THEME_NAME_ENV_VAR);
+    static const QString envThemeName = qEnvironmentVariable(GTK_THEME_NAME_ENV_VAR);
     if (!envThemeName.isEmpty()) {
         return envThemeName.contains(kdark, Qt::CaseInsensitive);
     }
 
-    /*
-        https://docs.gtk.org/gtk3/property.Settings.gtk-application-prefer-dark-theme.html
+    // The result is cached by FramelessManager, this function is called
+    // for every window whenever its colors are updated.
+    return FramelessManagerPrivate::desktopPrefersDarkTheme();
+}
 
-        This setting controls which theme is used when the theme specified by
-        gtk-theme-name provides both light and dark variants. We can save a
-        regex check by testing this property first.
-    */
-    const auto preferDark = gtkSettings<bool>(GTK_THEME_PREFER_DARK_PROP);
-    if (preferDark) {
+bool Utils::isGtkThemeBackendEnabled()
+{
+#ifdef FRAMELESSHELPER_CORE_NO_GTK
+    return false;
+#else // !FRAMELESSHELPER_CORE_NO_GTK
+    // Core::initialize() asks before the application object exists. The config file
+    // can't be found at that time, and loading FramelessConfig that early would make
+    // it ignore the file later, so only the environment variable is checked until then.
+    static const bool disabledByEnvVar = (qEnvironmentVariableIntValue(kDisableGtkThemeBackendVar.constData()) > 0);
+    if (disabledByEnvVar) {
+        return false;
+    }
+    if (!QCoreApplication::instance()) {
         return true;
     }
+    return !FramelessConfig::instance()->isSet(Option::DisableGtkThemeBackend);
+#endif // FRAMELESSHELPER_CORE_NO_GTK
+}
+
+[[nodiscard]] static inline QVariant readXdgPortalSetting(const char *key)
+{
+    Q_ASSERT(key);
+    if (!key) {
+        return {};
+    }
+#ifdef FRAMELESSHELPER_CORE_HAS_DBUS
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.isConnected()) {
+        return {};
+    }
+    // "Read" is deprecated in favor of "ReadOne" but it's the only one that
+    // older portal implementations have. It wraps the value in one more variant.
+    QDBusMessage message = QDBusMessage::createMethodCall(QUtf8String(XDG_PORTAL_SERVICE),
+        QUtf8String(XDG_PORTAL_PATH), QUtf8String(XDG_PORTAL_SETTINGS_INTERFACE),
+        QUtf8String(XDG_PORTAL_SETTINGS_READ_METHOD));
+    message << QUtf8String(XDG_APPEARANCE_NAMESPACE) << QUtf8String(key);
+    // Don't let a hanging portal block the GUI thread for the default 25 seconds.
+    static constexpr const int kTimeout = 500;
+    const QDBusMessage reply = bus.call(message, QDBus::Block, kTimeout);
+    if ((reply.type() != QDBusMessage::ReplyMessage) || reply.arguments().isEmpty()) {
+        DEBUG << "Failed to read" << key << "from the XDG desktop portal:" << reply.errorMessage();
+        return {};
+    }
+    QVariant value = reply.arguments().constFirst();
+    while (value.userType() == qMetaTypeId<QDBusVariant>()) {
+        value = qvariant_cast<QDBusVariant>(value).variant();
+    }
+    return value;
+#else // !FRAMELESSHELPER_CORE_HAS_DBUS
+    return {};
+#endif // FRAMELESSHELPER_CORE_HAS_DBUS
+}
+
+[[nodiscard]] static inline QVariant readGtkSettingsIniValue(const char *key)
+{
+    Q_ASSERT(key);
+    if (!key) {
+        return {};
+    }
+    // GTK reads the user's file first and then the system wide ones, so does QStandardPaths.
+    const QString filePath = QStandardPaths::locate(QStandardPaths::GenericConfigLocation, QUtf8String(GTK_SETTINGS_INI_FILE));
+    if (filePath.isEmpty()) {
+        return {};
+    }
+    const QSettings settings(filePath, QSettings::IniFormat);
+    return settings.value(QUtf8String(GTK_SETTINGS_INI_GROUP) + u'/' + QUtf8String(key));
+}
+
+bool Utils::queryDarkThemePreference()
+{
+#ifndef FRAMELESSHELPER_CORE_NO_GTK
+    if (isGtkThemeBackendEnabled()) {
+        /*
+            https://docs.gtk.org/gtk3/property.Settings.gtk-application-prefer-dark-theme.html
+
+            This setting controls which theme is used when the theme specified by
+            gtk-theme-name provides both light and dark variants. We can save a
+            regex check by testing this property first.
+        */
+        if (gtkSettings<bool>(GTK_THEME_PREFER_DARK_PROP)) {
+            return true;
+        }
+        /*
+            https://docs.gtk.org/gtk3/property.Settings.gtk-theme-name.html
+        */
+        return gtkSettings(GTK_THEME_NAME_PROP).contains(kdark, Qt::CaseInsensitive);
+    }
+#endif // FRAMELESSHELPER_CORE_NO_GTK
 
     /*
-        https://docs.gtk.org/gtk3/property.Settings.gtk-theme-name.html
+        https://flatpak.github.io/xdg-desktop-portal/docs/doc-org.freedesktop.portal.Settings.html
+
+        color-scheme: 0 means no preference, 1 means prefer dark appearance and
+        2 means prefer light appearance.
     */
-    const auto curThemeName = gtkSettings(GTK_THEME_NAME_PROP);
-    if (!curThemeName.isEmpty()) {
-        return curThemeName.contains(kdark, Qt::CaseInsensitive);
+    const QVariant colorScheme = readXdgPortalSetting(XDG_APPEARANCE_COLOR_SCHEME_KEY);
+    if (colorScheme.isValid()) {
+        const uint value = colorScheme.toUInt();
+        if ((value == 1) || (value == 2)) {
+            return (value == 1);
+        }
     }
 
-    return false;
+    // No portal or no preference: read the same settings GTK would have given us.
+    if (readGtkSettingsIniValue(GTK_THEME_PREFER_DARK_PROP).toBool()) {
+        return true;
+    }
+    return readGtkSettingsIniValue(GTK_THEME_NAME_PROP).toString().contains(kdark, Qt::CaseInsensitive);
+}
+
+QColor Utils::queryAccentColor()
+{
+    if (isGtkThemeBackendEnabled()) {
+        return {};
+    }
+#ifdef FRAMELESSHELPER_CORE_HAS_DBUS
+    // accent-color is a (ddd) tuple of sRGB values in the [0, 1] range,
+    // anything outside of that range means the accent color is not set.
+    const QVariant value = readXdgPortalSetting(XDG_APPEARANCE_ACCENT_COLOR_KEY);
+    if (value.userType() != qMetaTypeId<QDBusArgument>()) {
+        return {};
+    }
+    const auto argument = qvariant_cast<QDBusArgument>(value);
+    if (argument.currentType() != QDBusArgument::StructureType) {
+        return {};
+    }
+    double red = -1.0;
+    double green = -1.0;
+    double blue = -1.0;
+    argument.beginStructure();
+    argument >> red >> green >> blue;
+    argument.endStructure();
+    const auto inRange = [](const double component) -> bool {
+        return ((component >= 0.0) && (component <= 1.0));
+    };
+    if (!inRange(red) || !inRange(green) || !inRange(blue)) {
+        return {};
+    }
+    return QColor::fromRgbF(red, green, blue);
+#else // !FRAMELESSHELPER_CORE_HAS_DBUS
+    return {};
+#endif // FRAMELESSHELPER_CORE_HAS_DBUS
 }
 
 bool Utils::setBlurBehindWindowEnabled(const WId windowId, const BlurMode mode, const QColor &color)
@@ -444,14 +629,16 @@ bool Utils::setBlurBehindWindowEnabled(const WId windowId, const BlurMode mode,
     if (!windowId) {
         return false;
     }
-    static const xcb_atom_t atom = internAtom(ATOM_KDE_NET_WM_BLUR_BEHIND_REGION);
+    const xcb_atom_t atom = x11_atom(X11Atom::KdeNetWmBlurBehindRegion);
     if ((atom == XCB_NONE) || !isSupportedByRootWindow(atom)) {
         WARNING << "Current window manager doesn't support blur behind window.";
         return false;
     }
-    static const xcb_atom_t deepinAtom = internAtom(ATOM_NET_WM_DEEPIN_BLUR_REGION_MASK);
+    // Everything below is sent to the X server in one go.
+    X11RequestBatch batch;
+    const xcb_atom_t deepinAtom = x11_atom(X11Atom::NetWmDeepinBlurRegionMask);
     if ((deepinAtom != XCB_NONE) && isSupportedByWindowManager(deepinAtom)) {
-        clearWindowProperty(windowId, deepinAtom);
+        batch.clearWindowProperty(windowId, deepinAtom);
     }
     const auto blurMode = [mode]() -> BlurMode {
         if ((mode == BlurMode::Disable) || (mode == BlurMode::Default)) {
@@ -461,10 +648,10 @@ bool Utils::setBlurBehindWindowEnabled(const WId windowId, const BlurMode mode,
         return BlurMode::Default;
     }();
     if (blurMode == BlurMode::Disable) {
-        clearWindowProperty(windowId, atom);
+        batch.clearWindowProperty(windowId, atom);
     } else {
         const quint32 value = true;
-        setWindowProperty(windowId, atom, XCB_ATOM_CARDINAL, &value, 1, sizeof(quint32) * 8);
+        batch.setWindowProperty(windowId, atom, XCB_ATOM_CARDINAL, &value, 1, sizeof(quint32) * 8);
     }
     return true;
 }
@@ -483,25 +670,102 @@ WallpaperAspectStyle Utils::getWallpaperAspectStyle()
 
 bool Utils::isBlurBehindWindowSupported()
 {
-    static const auto result = []() -> bool {
-        if (FramelessConfig::instance()->isSet(Option::ForceNonNativeBackgroundBlur)) {
+    // Not cached, the answer changes with the window manager (FramelessManager::windowManagerChanged()).
+    if (FramelessConfig::instance()->isSet(Option::ForceNonNativeBackgroundBlur)) {
+        return false;
+    }
+    return false; // FIXME: check what's wrong.
+    const QString windowManager = getWindowManagerName();
+    const bool isDeepinV15 = (windowManager == FRAMELESSHELPER_STRING_LITERAL("Mutter(DeepinGala)"));
+    if (isDeepinV15) {
+        const xcb_atom_t atom = x11_atom(X11Atom::NetWmDeepinBlurRegionRounded);
+        return ((atom != XCB_NONE) && isSupportedByWindowManager(atom));
+    }
+    const bool isKWin = (windowManager == FRAMELESSHELPER_STRING_LITERAL("KWin"));
+    if (isKWin) {
+        const xcb_atom_t atom = x11_atom(X11Atom::KdeNetWmBlurBehindRegion);
+        return ((atom != XCB_NONE) && isSupportedByRootWindow(atom));
+    }
+    return false;
+}
+
+// Qt already listens to the property changes of the root window, we only have to look at them.
+// A new window manager announces itself by replacing _NET_SUPPORTING_WM_CHECK (and usually
+// _NET_SUPPORTED), and effects such as KWin's blur add or remove their root window properties
+// when they are loaded or unloaded.
+class X11RootWindowWatcher : public QAbstractNativeEventFilter
+{
+    Q_DISABLE_COPY_MOVE(X11RootWindowWatcher)
+
+public:
+    explicit X11RootWindowWatcher() = default;
+    ~X11RootWindowWatcher() override = default;
+
+    Q_NODISCARD bool nativeEventFilter(const QByteArray &eventType, void *message, QT_NATIVE_EVENT_RESULT_TYPE *result) override
+    {
+        Q_UNUSED(result);
+        if (!message || (eventType != FRAMELESSHELPER_BYTEARRAY_LITERAL("xcb_generic_event_t"))) {
             return false;
         }
-        return false; // FIXME: check what's wrong.
-        static const QString windowManager = getWindowManagerName();
-        static const bool isDeepinV15 = (windowManager == FRAMELESSHELPER_STRING_LITERAL("Mutter(DeepinGala)"));
-        if (isDeepinV15) {
-            static const xcb_atom_t atom = internAtom(ATOM_NET_WM_DEEPIN_BLUR_REGION_ROUNDED);
-            return ((atom != XCB_NONE) && isSupportedByWindowManager(atom));
+        const auto event = static_cast<const xcb_generic_event_t *>(message);
+        if ((event->response_type & ~0x80) != XCB_PROPERTY_NOTIFY) {
+            return false;
         }
-        static const bool isKWin = (windowManager == FRAMELESSHELPER_STRING_LITERAL("KWin"));
-        if (isKWin) {
-            static const xcb_atom_t atom = internAtom(ATOM_KDE_NET_WM_BLUR_BEHIND_REGION);
-            return ((atom != XCB_NONE) && isSupportedByRootWindow(atom));
+        const auto propertyEvent = static_cast<const xcb_property_notify_event_t *>(message);
+        if (propertyEvent->window != Utils::x11_appRootWindow(Utils::x11_appScreen())) {
+            return false;
+        }
+        const xcb_atom_t atom = propertyEvent->atom;
+        const bool windowManagerChanged = ((atom == Utils::x11_atom(X11Atom::NetSupportingWmCheck))
+            || (atom == Utils::x11_atom(X11Atom::NetSupported)));
+        bool notify = windowManagerChanged;
+        {
+            const QMutexLocker locker(&g_x11WindowManagerData()->mutex);
+            X11WindowManagerData * const data = g_x11WindowManagerData();
+            if (windowManagerChanged) {
+                data->nameValid = false;
+                data->supportedAtomsValid = false;
+            }
+            // Only a property that is new to us or has been deleted changes the list, the
+            // others have just changed their values.
+            if (data->rootWindowPropertiesValid && (windowManagerChanged
+                    || (propertyEvent->state == XCB_PROPERTY_DELETE) || !data->rootWindowProperties.contains(atom))) {
+                data->rootWindowPropertiesValid = false;
+            }
+        }
+        if (!notify) {
+            for (int i = 0; i != kX11AtomCount; ++i) {
+                if (atom == Utils::x11_atom(static_cast<X11Atom>(i))) {
+                    notify = true;
+                    break;
+                }
+            }
+        }
+        if (notify) {
+            // Sometimes the FramelessManager instance may be destroyed already.
+            if (FramelessManager * const manager = FramelessManager::instance()) {
+                if (FramelessManagerPrivate * const managerPriv = FramelessManagerPrivate::get(manager)) {
+                    managerPriv->notifyWindowManagerHasChanged();
+                }
+            }
         }
         return false;
-    }();
-    return result;
+    }
+};
+
+void Utils::registerWindowManagerChangeNotification()
+{
+    static bool registered = false;
+    if (registered) {
+        return;
+    }
+    Q_ASSERT(QCoreApplication::instance());
+    if (!QCoreApplication::instance()) {
+        return;
+    }
+    registered = true;
+    static X11RootWindowWatcher watcher;
+    qApp->installNativeEventFilter(&watcher);
 }
 
 static inline void themeChangeNotificationCallback()
@@ -509,13 +773,17 @@ static inline void themeChangeNotificationCallback()
     // Sometimes the FramelessManager instance may be destroyed already.
     if (FramelessManager * const manager = FramelessManager::instance()) {
         if (FramelessManagerPrivate * const managerPriv = FramelessManagerPrivate::get(manager)) {
-            managerPriv->notifySystemThemeHasChangedOrNot();
+            managerPriv->notifyDesktopThemeHasChanged();
         }
     }
 }
 
 void Utils::registerThemeChangeNotification()
 {
+    // The XDG desktop portal is already watched by FramelessManager.
+    if (!isGtkThemeBackendEnabled()) {
+        return;
+    }
     GtkSettings * const settings = gtk_settings_get_default();
     Q_ASSERT(settings);
     if (!settings) {
@@ -523,6 +791,7 @@ void Utils::registerThemeChangeNotification()
     }
     g_signal_connect(settings, "notify::gtk-application-prefer-dark-theme", themeChangeNotificationCallback, nullptr);
     g_signal_connect(settings, "notify::gtk-theme-name", themeChangeNotificationCallback, nullptr);
+    FramelessManagerPrivate::setDesktopThemeWatched(true);
 }
 
 QColor Utils::getFrameBorderColor(const bool active)
@@ -552,69 +821,184 @@ xcb_atom_t Utils::internAtom(const char *name)
     return atom;
 }
 
-QString Utils::getWindowManagerName()
+xcb_atom_t Utils::x11_atom(const X11Atom atom)
 {
-    static const auto result = []() -> QString {
-        xcb_connection_t * const connection = x11_connection();
-        Q_ASSERT(connection);
-        if (!connection) {
-            return {};
-        }
-        const quint32 rootWindow = x11_appRootWindow(x11_appScreen());
-        Q_ASSERT(rootWindow);
-        if (!rootWindow) {
-            return {};
-        }
-        static const xcb_atom_t wmCheckAtom = internAtom(ATOM_NET_SUPPORTING_WM_CHECK);
-        if (wmCheckAtom == XCB_NONE) {
-            WARNING << "Failed to retrieve the atom of _NET_SUPPORTING_WM_CHECK.";
-            return {};
+    const auto index = static_cast<int>(atom);
+    Q_ASSERT((index >= 0) && (index < kX11AtomCount));
+    if ((index < 0) || (index >= kX11AtomCount)) {
+        return XCB_NONE;
+    }
+    if (!g_x11AtomData()->initialized.load(std::memory_order_acquire)) {
+        const QMutexLocker locker(&g_x11AtomData()->mutex);
+        if (!g_x11AtomData()->initialized.load(std::memory_order_relaxed)) {
+            xcb_connection_t * const connection = x11_connection();
+            Q_ASSERT(connection);
+            if (!connection) {
+                return XCB_NONE;
+            }
+            // Send all the requests first and only then wait for the replies, so that
+            // all the atoms together cost a single round trip to the X server.
+            xcb_intern_atom_cookie_t cookies[kX11AtomCount] = {};
+            for (int i = 0; i != kX11AtomCount; ++i) {
+                cookies[i] = xcb_intern_atom(connection, false, qstrlen(kX11AtomNames[i]), kX11AtomNames[i]);
+            }
+            for (int i = 0; i != kX11AtomCount; ++i) {
+                xcb_intern_atom_reply_t * const reply = xcb_intern_atom_reply(connection, cookies[i], nullptr);
+                if (!reply) {
+                    WARNING << "Failed to intern the atom" << kX11AtomNames[i];
+                    continue;
+                }
+                g_x11AtomData()->atoms[i] = reply->atom;
+                std::free(reply);
+            }
+            g_x11AtomData()->initialized.store(true, std::memory_order_release);
         }
-        const xcb_get_property_cookie_t cookie = xcb_get_property_unchecked(connection, false, rootWindow, wmCheckAtom, XCB_ATOM_WINDOW, 0, 1024);
+    }
+    return g_x11AtomData()->atoms[index];
+}
+
+// The queries behind the window manager cache, they always ask the X server.
+[[nodiscard]] static inline QString queryWindowManagerName()
+{
+    xcb_connection_t * const connection = Utils::x11_connection();
+    Q_ASSERT(connection);
+    if (!connection) {
+        return {};
+    }
+    const quint32 rootWindow = Utils::x11_appRootWindow(Utils::x11_appScreen());
+    Q_ASSERT(rootWindow);
+    if (!rootWindow) {
+        return {};
+    }
+    const xcb_atom_t wmCheckAtom = Utils::x11_atom(X11Atom::NetSupportingWmCheck);
+    if (wmCheckAtom == XCB_NONE) {
+        WARNING << "Failed to retrieve the atom of _NET_SUPPORTING_WM_CHECK.";
+        return {};
+    }
+    const xcb_get_property_cookie_t cookie = xcb_get_property_unchecked(connection, false, rootWindow, wmCheckAtom, XCB_ATOM_WINDOW, 0, 1024);
+    xcb_get_property_reply_t * const reply = xcb_get_property_reply(connection, cookie, nullptr);
+    if (!reply) {
+        return {};
+    }
+    if (!((reply->format == 32) && (reply->type == XCB_ATOM_WINDOW))) {
+        std::free(reply);
+        return {};
+    }
+    const auto windowManager = *static_cast<xcb_window_t *>(xcb_get_property_value(reply));
+    if (windowManager == XCB_WINDOW_NONE) {
+        std::free(reply);
+        return {};
+    }
+    const xcb_atom_t wmNameAtom = Utils::x11_atom(X11Atom::NetWmName);
+    if (wmNameAtom == XCB_NONE) {
+        WARNING << "Failed to retrieve the atom of _NET_WM_NAME.";
+        return {};
+    }
+    const xcb_atom_t strAtom = Utils::x11_atom(X11Atom::Utf8String);
+    if (strAtom == XCB_NONE) {
+        WARNING << "Failed to retrieve the atom of UTF8_STRING.";
+        return {};
+    }
+    const xcb_get_property_cookie_t wmCookie = xcb_get_property_unchecked(connection, false, windowManager, wmNameAtom, strAtom, 0, 1024);
+    xcb_get_property_reply_t * const wmReply = xcb_get_property_reply(connection, wmCookie, nullptr);
+    if (!wmReply) {
+        std::free(reply);
+        return {};
+    }
+    if (!((wmReply->format == 8) && (wmReply->type == strAtom))) {
+        std::free(wmReply);
+        std::free(reply);
+        return {};
+    }
+    const auto data = static_cast<const char *>(xcb_get_property_value(wmReply));
+    const int len = xcb_get_property_value_length(wmReply);
+    const QString wmName = QString::fromUtf8(data, len);
+    std::free(wmReply);
+    std::free(reply);
+    return wmName;
+}
+
+[[nodiscard]] static inline QSet<xcb_atom_t> queryNetSupportedAtoms()
+{
+    xcb_connection_t * const connection = Utils::x11_connection();
+    Q_ASSERT(connection);
+    if (!connection) {
+        return {};
+    }
+    const quint32 rootWindow = Utils::x11_appRootWindow(Utils::x11_appScreen());
+    Q_ASSERT(rootWindow);
+    if (!rootWindow) {
+        return {};
+    }
+    const xcb_atom_t netSupportedAtom = Utils::x11_atom(X11Atom::NetSupported);
+    if (netSupportedAtom == XCB_NONE) {
+        WARNING << "Failed to retrieve the atom of _NET_SUPPORTED.";
+        return {};
+    }
+    QSet<xcb_atom_t> result = {};
+    int offset = 0;
+    int remaining = 0;
+    do {
+        const xcb_get_property_cookie_t cookie = xcb_get_property(connection, false, rootWindow, netSupportedAtom, XCB_ATOM_ATOM, offset, 1024);
         xcb_get_property_reply_t * const reply = xcb_get_property_reply(connection, cookie, nullptr);
         if (!reply) {
-            return {};
-        }
-        if (!((reply->format == 32) && (reply->type == XCB_ATOM_WINDOW))) {
-            std::free(reply);
-            return {};
-        }
-        const auto windowManager = *static_cast<xcb_window_t *>(xcb_get_property_value(reply));
-        if (windowManager == XCB_WINDOW_NONE) {
-            std::free(reply);
-            return {};
-        }
-        static const xcb_atom_t wmNameAtom = internAtom(ATOM_NET_WM_NAME);
-        if (wmNameAtom == XCB_NONE) {
-            WARNING << "Failed to retrieve the atom of _NET_WM_NAME.";
-            return {};
+            break;
         }
-        static const xcb_atom_t strAtom = internAtom(ATOM_UTF8_STRING);
-        if (strAtom == XCB_NONE) {
-            WARNING << "Failed to retrieve the atom of UTF8_STRING.";
-            return {};
-        }
-        const xcb_get_property_cookie_t wmCookie = xcb_get_property_unchecked(connection, false, windowManager, wmNameAtom, strAtom, 0, 1024);
-        xcb_get_property_reply_t * const wmReply = xcb_get_property_reply(connection, wmCookie, nullptr);
-        if (!wmReply) {
-            std::free(reply);
-            return {};
-        }
-        if (!((wmReply->format == 8) && (wmReply->type == strAtom))) {
-            std::free(wmReply);
-            std::free(reply);
-            return {};
+        remaining = 0;
+        if ((reply->type == XCB_ATOM_ATOM) && (reply->format == 32)) {
+            const int len = (xcb_get_property_value_length(reply) / sizeof(xcb_atom_t));
+            const auto atoms = static_cast<const xcb_atom_t *>(xcb_get_property_value(reply));
+            result.reserve(result.size() + len);
+            for (int i = 0; i != len; ++i) {
+                result.insert(atoms[i]);
+            }
+            remaining = reply->bytes_after;
+            offset += len;
         }
-        const auto data = static_cast<const char *>(xcb_get_property_value(wmReply));
-        const int len = xcb_get_property_value_length(wmReply);
-        const QString wmName = QString::fromUtf8(data, len);
-        std::free(wmReply);
         std::free(reply);
-        return wmName;
-    }();
+    } while (remaining > 0);
     return result;
 }
 
+[[nodiscard]] static inline QSet<xcb_atom_t> queryRootWindowProperties()
+{
+    xcb_connection_t * const connection = Utils::x11_connection();
+    Q_ASSERT(connection);
+    if (!connection) {
+        return {};
+    }
+    const quint32 rootWindow = Utils::x11_appRootWindow(Utils::x11_appScreen());
+    Q_ASSERT(rootWindow);
+    if (!rootWindow) {
+        return {};
+    }
+    const xcb_list_properties_cookie_t cookie = xcb_list_properties(connection, rootWindow);
+    xcb_list_properties_reply_t * const reply = xcb_list_properties_reply(connection, cookie, nullptr);
+    if (!reply) {
+        return {};
+    }
+    const int len = xcb_list_properties_atoms_length(reply);
+    const auto atoms = static_cast<const xcb_atom_t *>(xcb_list_properties_atoms(reply));
+    QSet<xcb_atom_t> result = {};
+    result.reserve(len);
+    for (int i = 0; i != len; ++i) {
+        result.insert(atoms[i]);
+    }
+    std::free(reply);
+    return result;
+}
+
+QString Utils::getWindowManagerName()
+{
+    const QMutexLocker locker(&g_x11WindowManagerData()->mutex);
+    X11WindowManagerData * const data = g_x11WindowManagerData();
+    if (!data->nameValid) {
+        data->name = queryWindowManagerName();
+        data->nameValid = true;
+    }
+    return data->name;
+}
+
 void Utils::openSystemMenu(const WId windowId, const QPoint &globalPos)
 {
     Q_ASSERT(windowId);
@@ -634,7 +1018,7 @@ void Utils::openSystemMenu(const WId windowId, const QPoint &globalPos)
         return;
     }
 
-    static const xcb_atom_t atom = internAtom(ATOM_GTK_SHOW_WINDOW_MENU);
+    const xcb_atom_t atom = x11_atom(X11Atom::GtkShowWindowMenu);
     if ((atom == XCB_NONE) || !isSupportedByWindowManager(atom)) {
         WARNING << "Current window manager doesn't support showing window menu.";
         return;
@@ -718,51 +1102,13 @@ bool Utils::isSupportedByWindowManager(const xcb_atom_t atom)
     if (atom == XCB_NONE) {
         return false;
     }
-#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
-    using result_type = QList<xcb_atom_t>;
-#else // (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    using result_type = QVector<xcb_atom_t>;
-#endif // (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
-    static const auto netWmAtoms = []() -> result_type {
-        xcb_connection_t * const connection = x11_connection();
-        Q_ASSERT(connection);
-        if (!connection) {
-            return {};
-        }
-        const quint32 rootWindow = x11_appRootWindow(x11_appScreen());
-        Q_ASSERT(rootWindow);
-        if (!rootWindow) {
-            return {};
-        }
-        static const xcb_atom_t netSupportedAtom = internAtom(ATOM_NET_SUPPORTED);
-        if (netSupportedAtom == XCB_NONE) {
-            WARNING << "Failed to retrieve the atom of _NET_SUPPORTED.";
-            return {};
-        }
-        result_type result = {};
-        int offset = 0;
-        int remaining = 0;
-        do {
-            const xcb_get_property_cookie_t cookie = xcb_get_property(connection, false, rootWindow, netSupportedAtom, XCB_ATOM_ATOM, offset, 1024);
-            xcb_get_property_reply_t * const reply = xcb_get_property_reply(connection, cookie, nullptr);
-            if (!reply) {
-                break;
-            }
-            remaining = 0;
-            if ((reply->type == XCB_ATOM_ATOM) && (reply->format == 32)) {
-                const int len = (xcb_get_property_value_length(reply) / sizeof(xcb_atom_t));
-                const auto atoms = static_cast<xcb_atom_t *>(xcb_get_property_value(reply));
-                const int size = result.size();
-                result.resize(size + len);
-                std::memcpy(result.data() + size, atoms, len * sizeof(xcb_atom_t));
-                remaining = reply->bytes_after;
-                offset += len;
-            }
-            std::free(reply);
-        } while (remaining > 0);
-        return result;
-    }();
-    return netWmAtoms.contains(atom);
+    const QMutexLocker locker(&g_x11WindowManagerData()->mutex);
+    X11WindowManagerData * const data = g_x11WindowManagerData();
+    if (!data->supportedAtomsValid) {
+        data->supportedAtoms = queryNetSupportedAtoms();
+        data->supportedAtomsValid = true;
+    }
+    return data->supportedAtoms.contains(atom);
 }
 
 bool Utils::isSupportedByRootWindow(const xcb_atom_t atom)
@@ -771,36 +1117,13 @@ bool Utils::isSupportedByRootWindow(const xcb_atom_t atom)
     if (atom == XCB_NONE) {
         return false;
     }
-#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
-    using result_type = QList<xcb_atom_t>;
-#else // (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    using result_type = QVector<xcb_atom_t>;
-#endif // (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
-    static const auto rootWindowProperties = []() -> result_type {
-        xcb_connection_t * const connection = x11_connection();
-        Q_ASSERT(connection);
-        if (!connection) {
-            return {};
-        }
-        const quint32 rootWindow = x11_appRootWindow(x11_appScreen());
-        Q_ASSERT(rootWindow);
-        if (!rootWindow) {
-            return {};
-        }
-        result_type result = {};
-        const xcb_list_properties_cookie_t cookie = xcb_list_properties(connection, rootWindow);
-        xcb_list_properties_reply_t * const reply = xcb_list_properties_reply(connection, cookie, nullptr);
-        if (!reply) {
-            return {};
-        }
-        const int len = xcb_list_properties_atoms_length(reply);
-        const auto atoms = static_cast<xcb_atom_t *>(xcb_list_properties_atoms(reply));
-        result.resize(len);
-        std::memcpy(result.data(), atoms, len * sizeof(xcb_atom_t));
-        std::free(reply);
-        return result;
-    }();
-    return rootWindowProperties.contains(atom);
+    const QMutexLocker locker(&g_x11WindowManagerData()->mutex);
+    X11WindowManagerData * const data = g_x11WindowManagerData();
+    if (!data->rootWindowPropertiesValid) {
+        data->rootWindowProperties = queryRootWindowProperties();
+        data->rootWindowPropertiesValid = true;
+    }
+    return data->rootWindowProperties.contains(atom);
 }
 
 bool Utils::tryHideSystemTitleBar(const WId windowId, const bool hide)
@@ -809,21 +1132,23 @@ bool Utils::tryHideSystemTitleBar(const WId windowId, const bool hide)
     if (!windowId) {
         return false;
     }
-    static const xcb_atom_t deepinNoTitleBarAtom = internAtom(ATOM_DEEPIN_NO_TITLEBAR);
+    const xcb_atom_t deepinNoTitleBarAtom = x11_atom(X11Atom::DeepinNoTitleBar);
     if ((deepinNoTitleBarAtom == XCB_NONE) || !isSupportedByWindowManager(deepinNoTitleBarAtom)) {
         WARNING << "Current window manager doesn't support hiding title bar natively.";
         return false;
     }
+    // Both properties are sent to the X server in one go.
+    X11RequestBatch batch;
     const quint32 value = hide;
-    setWindowProperty(windowId, deepinNoTitleBarAtom, XCB_ATOM_CARDINAL, &value, 1, sizeof(quint32) * 8);
-    static const xcb_atom_t deepinForceDecorateAtom = internAtom(ATOM_DEEPIN_FORCE_DECORATE);
+    batch.setWindowProperty(windowId, deepinNoTitleBarAtom, XCB_ATOM_CARDINAL, &value, 1, sizeof(quint32) * 8);
+    const xcb_atom_t deepinForceDecorateAtom = x11_atom(X11Atom::DeepinForceDecorate);
     if ((deepinForceDecorateAtom == XCB_NONE) || !isSupportedByWindowManager(deepinForceDecorateAtom)) {
         return true;
     }
     if (hide) {
-        setWindowProperty(windowId, deepinForceDecorateAtom, XCB_ATOM_CARDINAL, &value, 1, sizeof(quint32) * 8);
+        batch.setWindowProperty(windowId, deepinForceDecorateAtom, XCB_ATOM_CARDINAL, &value, 1, sizeof(quint32) * 8);
     } else {
-        clearWindowProperty(windowId, deepinForceDecorateAtom);
+        batch.clearWindowProperty(windowId, deepinForceDecorateAtom);
     }
     return true;
 }
@@ -846,7 +1171,7 @@ void Utils::sendMoveResizeMessage(const WId windowId, const uint32_t action, con
         return;
     }
 
-    static const xcb_atom_t atom = internAtom(ATOM_NET_WM_MOVERESIZE);
+    const xcb_atom_t atom = x11_atom(X11Atom::NetWmMoveResize);
     if ((atom == XCB_NONE) || !isSupportedByWindowManager(atom)) {
         WARNING << "Current window manager doesn't support move resize operation.";
         return;
@@ -881,7 +1206,7 @@ void Utils::sendMoveResizeMessage(const WId windowId, const uint32_t action, con
 
 bool Utils::isCustomDecorationSupported()
 {
-    static const xcb_atom_t atom = internAtom(ATOM_DEEPIN_NO_TITLEBAR);
+    const xcb_atom_t atom = x11_atom(X11Atom::DeepinNoTitleBar);
     return ((atom != XCB_NONE) && isSupportedByWindowManager(atom));
 }
 
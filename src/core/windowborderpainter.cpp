@@ -103,11 +103,11 @@ WindowEdges WindowBorderPainterPrivate::getNativeBorderEdges()
     return {};
 }
 
-void WindowBorderPainterPrivate::paint(QPainter *painter, const QSize &size, const bool active) const
+void WindowBorderPainterPrivate::paint(QPainter *painter, const QSize &size, const bool active, const QRegion &exposedRegion) const
 {
     Q_ASSERT(painter);
     Q_ASSERT(!size.isEmpty());
-    if (!painter || size.isEmpty()) {
+    if (!painter || size.isEmpty() || exposedRegion.isEmpty()) {
         return;
     }
 #if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
@@ -126,16 +126,24 @@ void WindowBorderPainterPrivate::paint(QPainter *painter, const QSize &size, con
     const QPoint rightBottom = {size.width(), size.height()};
     const QPoint leftBottom = {0, size.height()};
     const WindowEdges edges = m_edges.value_or(getNativeBorderEdges());
-    if (edges & WindowEdge::Left) {
+    const int thickness = m_thickness.value_or(getNativeBorderThickness());
+    // Edges outside of the exposed region are left untouched. The pen is centered
+    // on the line, so leave a generous margin around it.
+    const int band = (qMax(thickness, 1) * 2);
+    const auto isEdgeExposed = [&exposedRegion, band](const QPoint &p1, const QPoint &p2) -> bool {
+        const QRect lineRect = QRect(p1, p2).normalized();
+        return exposedRegion.intersects(lineRect.adjusted(-band, -band, band, band));
+    };
+    if ((edges & WindowEdge::Left) && isEdgeExposed(leftTop, leftBottom)) {
         lines.append({leftBottom, leftTop});
     }
-    if (edges & WindowEdge::Top) {
+    if ((edges & WindowEdge::Top) && isEdgeExposed(leftTop, rightTop)) {
         lines.append({leftTop, rightTop});
     }
-    if (edges & WindowEdge::Right) {
+    if ((edges & WindowEdge::Right) && isEdgeExposed(rightTop, rightBottom)) {
         lines.append({rightTop, rightBottom});
     }
-    if (edges & WindowEdge::Bottom) {
+    if ((edges & WindowEdge::Bottom) && isEdgeExposed(leftBottom, rightBottom)) {
         lines.append({rightBottom, leftBottom});
     }
     if (lines.isEmpty()) {
@@ -159,7 +167,7 @@ void WindowBorderPainterPrivate::paint(QPainter *painter, const QSize &size, con
         }
         return (active ? kDefaultBlackColor : kDefaultDarkGrayColor);
     }());
-    pen.setWidth(m_thickness.value_or(getNativeBorderThickness()));
+    pen.setWidth(thickness);
     painter->setPen(pen);
     painter->drawLines(lines);
     painter->restore();
@@ -231,7 +239,13 @@ QColor WindowBorderPainter::nativeInactiveColor() const
 void WindowBorderPainter::paint(QPainter *painter, const QSize &size, const bool active) const
 {
     Q_D(const WindowBorderPainter);
-    d->paint(painter, size, active);
+    d->paint(painter, size, active, QRegion(QRect(QPoint(0, 0), size)));
+}
+
+void WindowBorderPainter::paintRegion(QPainter *painter, const QSize &size, const bool active, const QRegion &exposedRegion) const
+{
+    Q_D(const WindowBorderPainter);
+    d->paint(painter, size, active, exposedRegion);
 }
 
 void WindowBorderPainter::setThickness(const int value)
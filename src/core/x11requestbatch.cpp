@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "x11requestbatch_p.h"
+#include "utils.h"
+
+FRAMELESSHELPER_BEGIN_NAMESPACE
+
+Q_LOGGING_CATEGORY(lcX11RequestBatch, "wangwenx190.framelesshelper.core.x11requestbatch")
+
+#ifdef FRAMELESSHELPER_CORE_NO_DEBUG_OUTPUT
+#  define INFO QT_NO_QDEBUG_MACRO()
+#  define DEBUG QT_NO_QDEBUG_MACRO()
+#  define WARNING QT_NO_QDEBUG_MACRO()
+#  define CRITICAL QT_NO_QDEBUG_MACRO()
+#else
+#  define INFO qCInfo(lcX11RequestBatch)
+#  define DEBUG qCDebug(lcX11RequestBatch)
+#  define WARNING qCWarning(lcX11RequestBatch)
+#  define CRITICAL qCCritical(lcX11RequestBatch)
+#endif
+
+X11RequestBatch::X11RequestBatch() : m_connection(Utils::x11_connection())
+{
+    Q_ASSERT(m_connection);
+    if (!m_connection) {
+        WARNING << "Failed to retrieve the XCB connection.";
+    }
+}
+
+X11RequestBatch::~X11RequestBatch()
+{
+    flush();
+}
+
+void X11RequestBatch::setWindowProperty(const WId windowId, const xcb_atom_t prop, const xcb_atom_t type,
+                                        const void *data, const quint32 data_len, const uint8_t format)
+{
+    Q_ASSERT(windowId);
+    Q_ASSERT(prop != XCB_NONE);
+    Q_ASSERT(type != XCB_NONE);
+    if (!windowId || (prop == XCB_NONE) || (type == XCB_NONE) || !m_connection) {
+        return;
+    }
+    // XCB copies the data into its output buffer, it doesn't have to outlive this call.
+    xcb_change_property(m_connection, XCB_PROP_MODE_REPLACE, windowId, prop, type, format, data_len, data);
+    m_hasWrites = true;
+}
+
+void X11RequestBatch::clearWindowProperty(const WId windowId, const xcb_atom_t prop)
+{
+    Q_ASSERT(windowId);
+    Q_ASSERT(prop != XCB_NONE);
+    if (!windowId || (prop == XCB_NONE) || !m_connection) {
+        return;
+    }
+    xcb_delete_property(m_connection, windowId, prop);
+    m_hasWrites = true;
+}
+
+void X11RequestBatch::flush()
+{
+    if (!m_connection || !m_hasWrites) {
+        return;
+    }
+    xcb_flush(m_connection);
+    m_hasWrites = false;
+}
+
+FRAMELESSHELPER_END_NAMESPACE
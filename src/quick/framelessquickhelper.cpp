@@ -70,7 +70,6 @@ using namespace Global;
 struct QuickHelperData
 {
     bool ready = false;
-    SystemParameters params = {};
     QPointer<QQuickItem> titleBarItem = nullptr;
     QList<QPointer<QQuickItem>> hitTestVisibleItems = {};
     QPointer<QQuickItem> windowIconButton = nullptr;
@@ -79,6 +78,8 @@ struct QuickHelperData
     QPointer<QQuickItem> maximizeButton = nullptr;
     QPointer<QQuickItem> closeButton = nullptr;
     QList<QRect> hitTestVisibleRects = {};
+    HitTestGeometry hitTestGeometry = {};
+    bool hitTestGeometryDirty = true;
 };
 
 struct QuickHelper
@@ -89,6 +90,62 @@ struct QuickHelper
 
 Q_GLOBAL_STATIC(QuickHelper, g_quickHelper)
 
+class QuickWindowAdapter final : public WindowAdapter
+{
+    Q_DISABLE_COPY_MOVE(QuickWindowAdapter)
+
+public:
+    explicit QuickWindowAdapter(FramelessQuickHelperPrivate *priv, QQuickWindow *window) : m_priv(priv), m_window(window)
+    {
+        Q_ASSERT(m_priv);
+        Q_ASSERT(m_window);
+    }
+
+    ~QuickWindowAdapter() override = default;
+
+    Q_NODISCARD Qt::WindowFlags getWindowFlags() const override { return m_window->flags(); }
+    void setWindowFlags(const Qt::WindowFlags flags) override { m_window->setFlags(flags); }
+    Q_NODISCARD QSize getWindowSize() const override { return m_window->size(); }
+    void setWindowSize(const QSize &size) override { m_window->resize(size); }
+    Q_NODISCARD QPoint getWindowPosition() const override { return m_window->position(); }
+    void setWindowPosition(const QPoint &pos) override { m_window->setX(pos.x()); m_window->setY(pos.y()); }
+    Q_NODISCARD QScreen *getWindowScreen() const override { return m_window->screen(); }
+    Q_NODISCARD bool isWindowFixedSize() const override { return m_priv->isWindowFixedSize(); }
+    void setWindowFixedSize(const bool value) override { m_priv->setWindowFixedSize(value); }
+    Q_NODISCARD Qt::WindowState getWindowState() const override { return m_window->windowState(); }
+    void setWindowState(const Qt::WindowState state) override { m_window->setWindowState(state); }
+    Q_NODISCARD QWindow *getWindowHandle() const override { return m_window; }
+    Q_NODISCARD QPoint windowToScreen(const QPoint &pos) const override { return m_window->mapToGlobal(pos); }
+    Q_NODISCARD QPoint screenToWindow(const QPoint &pos) const override { return m_window->mapFromGlobal(pos); }
+    Q_NODISCARD bool isInsideSystemButtons(const QPoint &pos, SystemButtonType *button) const override
+    {
+        QuickGlobal::SystemButtonType button2 = QuickGlobal::SystemButtonType::Unknown;
+        const bool result = m_priv->isInSystemButtons(pos, &button2);
+        *button = FRAMELESSHELPER_ENUM_QUICK_TO_CORE(SystemButtonType, button2);
+        return result;
+    }
+    Q_NODISCARD bool isInsideTitleBarDraggableArea(const QPoint &pos) const override { return m_priv->isInTitleBarDraggableArea(pos); }
+    Q_NODISCARD qreal getWindowDevicePixelRatio() const override { return m_window->effectiveDevicePixelRatio(); }
+    void setSystemButtonState(const SystemButtonType button, const ButtonState state) override
+    {
+        m_priv->setSystemButtonState(FRAMELESSHELPER_ENUM_CORE_TO_QUICK(SystemButtonType, button),
+                                     FRAMELESSHELPER_ENUM_CORE_TO_QUICK(ButtonState, state));
+    }
+    Q_NODISCARD WId getWindowId() const override { return m_window->winId(); }
+    Q_NODISCARD bool shouldIgnoreMouseEvents(const QPoint &pos) const override { return m_priv->shouldIgnoreMouseEvents(pos); }
+    void showSystemMenu(const QPoint &pos) override { m_priv->showSystemMenu(pos); }
+    void setProperty(const QByteArray &name, const QVariant &value) override { m_priv->setProperty(name, value); }
+    Q_NODISCARD QVariant getProperty(const QByteArray &name, const QVariant &defaultValue) const override { return m_priv->getProperty(name, defaultValue); }
+    void setCursor(const QCursor &cursor) override { m_window->setCursor(cursor); }
+    void unsetCursor() override { m_window->unsetCursor(); }
+    Q_NODISCARD QObject *getWidgetHandle() const override { return nullptr; }
+    Q_NODISCARD HitTestResult classify(const QPoint &pos) const override { return m_priv->classify(pos); }
+
+private:
+    FramelessQuickHelperPrivate *m_priv = nullptr;
+    QQuickWindow *m_window = nullptr;
+};
+
 FramelessQuickHelperPrivate::FramelessQuickHelperPrivate(FramelessQuickHelper *q) : QObject(q)
 {
     Q_ASSERT(q);
@@ -166,6 +223,8 @@ void FramelessQuickHelperPrivate::setTitleBarItem(QQuickItem *value)
         return;
     }
     data->titleBarItem = value;
+    data->hitTestGeometryDirty = true;
+    trackItemGeometry(value);
     emitSignalForAllInstances(FRAMELESSHELPER_BYTEARRAY_LITERAL("titleBarItemChanged"));
 }
 
@@ -186,49 +245,19 @@ void FramelessQuickHelperPrivate::attach()
     }
     g_quickHelper()->mutex.unlock();
 
-    SystemParameters params = {};
-    params.getWindowId = [window]() -> WId { return window->winId(); };
-    params.getWindowFlags = [window]() -> Qt::WindowFlags { return window->flags(); };
-    params.setWindowFlags = [window](const Qt::WindowFlags flags) -> void { window->setFlags(flags); };
-    params.getWindowSize = [window]() -> QSize { return window->size(); };
-    params.setWindowSize = [window](const QSize &size) -> void { window->resize(size); };
-    params.getWindowPosition = [window]() -> QPoint { return window->position(); };
-    params.setWindowPosition = [window](const QPoint &pos) -> void { window->setX(pos.x()); window->setY(pos.y()); };
-    params.getWindowScreen = [window]() -> QScreen * { return window->screen(); };
-    params.isWindowFixedSize = [this]() -> bool { return isWindowFixedSize(); };
-    params.setWindowFixedSize = [this](const bool value) -> void { setWindowFixedSize(value); };
-    params.getWindowState = [window]() -> Qt::WindowState { return window->windowState(); };
-    params.setWindowState = [window](const Qt::WindowState state) -> void { window->setWindowState(state); };
-    params.getWindowHandle = [window]() -> QWindow * { return window; };
-    params.windowToScreen = [window](const QPoint &pos) -> QPoint { return window->mapToGlobal(pos); };
-    params.screenToWindow = [window](const QPoint &pos) -> QPoint { return window->mapFromGlobal(pos); };
-    params.isInsideSystemButtons = [this](const QPoint &pos, SystemButtonType *button) -> bool {
-        QuickGlobal::SystemButtonType button2 = QuickGlobal::SystemButtonType::Unknown;
-        const bool result = isInSystemButtons(pos, &button2);
-        *button = FRAMELESSHELPER_ENUM_QUICK_TO_CORE(SystemButtonType, button2);
-        return result;
-    };
-    params.isInsideTitleBarDraggableArea = [this](const QPoint &pos) -> bool { return isInTitleBarDraggableArea(pos); };
-    params.getWindowDevicePixelRatio = [window]() -> qreal { return window->effectiveDevicePixelRatio(); };
-    params.setSystemButtonState = [this](const SystemButtonType button, const ButtonState state) -> void {
-        setSystemButtonState(FRAMELESSHELPER_ENUM_CORE_TO_QUICK(SystemButtonType, button),
-                             FRAMELESSHELPER_ENUM_CORE_TO_QUICK(ButtonState, state));
-    };
-    params.shouldIgnoreMouseEvents = [this](const QPoint &pos) -> bool { return shouldIgnoreMouseEvents(pos); };
-    params.showSystemMenu = [this](const QPoint &pos) -> void { showSystemMenu(pos); };
-    params.setProperty = [this](const QByteArray &name, const QVariant &value) -> void { setProperty(name, value); };
-    params.getProperty = [this](const QByteArray &name, const QVariant &defaultValue) -> QVariant { return getProperty(name, defaultValue); };
-    params.setCursor = [window](const QCursor &cursor) -> void { window->setCursor(cursor); };
-    params.unsetCursor = [window]() -> void { window->unsetCursor(); };
-    params.getWidgetHandle = []() -> QObject * { return nullptr; };
-
-    FramelessManager::instance()->addWindow(params);
+    m_windowAdapter = std::make_unique<QuickWindowAdapter>(this, window);
+    FramelessManager::instance()->addWindow(m_windowAdapter.get());
 
     g_quickHelper()->mutex.lock();
-    data->params = params;
     data->ready = true;
     g_quickHelper()->mutex.unlock();
 
+    // The title bar is clipped to the window rect, so a resize must invalidate it.
+    connect(window, &QQuickWindow::widthChanged, this,
+        &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+    connect(window, &QQuickWindow::heightChanged, this,
+        &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+
     // We have to wait for a little time before moving the top level window
     // , because the platform window may not finish initializing by the time
     // we reach here, and all the modifications from the Qt side will be lost
@@ -259,6 +288,7 @@ void FramelessQuickHelperPrivate::detach()
     }
     g_quickHelper()->data.remove(windowId);
     FramelessManager::instance()->removeWindow(windowId);
+    m_windowAdapter.reset();
 }
 
 void FramelessQuickHelperPrivate::setSystemButton(QQuickItem *item, const QuickGlobal::SystemButtonType buttonType)
@@ -294,6 +324,8 @@ void FramelessQuickHelperPrivate::setSystemButton(QQuickItem *item, const QuickG
         data->closeButton = item;
         break;
     }
+    data->hitTestGeometryDirty = true;
+    trackItemGeometry(item);
 }
 
 void FramelessQuickHelperPrivate::setHitTestVisible(QQuickItem *item, const bool visible)
@@ -310,9 +342,12 @@ void FramelessQuickHelperPrivate::setHitTestVisible(QQuickItem *item, const bool
     const bool exists = data->hitTestVisibleItems.contains(item);
     if (visible && !exists) {
         data->hitTestVisibleItems.append(item);
+        data->hitTestGeometryDirty = true;
+        trackItemGeometry(item);
     }
     if (!visible && exists) {
         data->hitTestVisibleItems.removeAll(item);
+        data->hitTestGeometryDirty = true;
     }
 }
 
@@ -330,9 +365,11 @@ void FramelessQuickHelperPrivate::setHitTestVisible(const QRect &rect, const boo
     const bool exists = data->hitTestVisibleRects.contains(rect);
     if (visible && !exists) {
         data->hitTestVisibleRects.append(rect);
+        data->hitTestGeometryDirty = true;
     }
     if (!visible && exists) {
         data->hitTestVisibleRects.removeAll(rect);
+        data->hitTestGeometryDirty = true;
     }
 }
 
@@ -678,89 +715,149 @@ bool FramelessQuickHelperPrivate::isInSystemButtons(const QPoint &pos, QuickGlob
     if (!button) {
         return false;
     }
-    *button = QuickGlobal::SystemButtonType::Unknown;
-    const QuickHelperData data = getWindowData();
-    if (data.windowIconButton && data.windowIconButton->isVisible() && data.windowIconButton->isEnabled()) {
-        if (mapItemGeometryToScene(data.windowIconButton).contains(pos)) {
-            *button = QuickGlobal::SystemButtonType::WindowIcon;
-            return true;
-        }
+    const HitTestResult result = hitTest(pos, false);
+    *button = FRAMELESSHELPER_ENUM_CORE_TO_QUICK(SystemButtonType, result.button);
+    return (result.zone == HitTestZone::SystemButton);
+}
+
+bool FramelessQuickHelperPrivate::isInTitleBarDraggableArea(const QPoint &pos) const
+{
+    return (hitTest(pos, false).zone == HitTestZone::Caption);
+}
+
+HitTestResult FramelessQuickHelperPrivate::classify(const QPoint &pos) const
+{
+    Q_Q(const FramelessQuickHelper);
+    const QQuickWindow * const window = q->window();
+    if (!window) {
+        return {};
     }
-    if (data.contextHelpButton && data.contextHelpButton->isVisible() && data.contextHelpButton->isEnabled()) {
-        if (mapItemGeometryToScene(data.contextHelpButton).contains(pos)) {
-            *button = QuickGlobal::SystemButtonType::Help;
-            return true;
-        }
+    return hitTest(pos, (window->visibility() == QQuickWindow::Windowed));
+}
+
+HitTestResult FramelessQuickHelperPrivate::hitTest(const QPoint &pos, const bool resizable) const
+{
+    Q_Q(const FramelessQuickHelper);
+    if (!q->window()) {
+        // The FramelessQuickHelper item has not been attached to a specific window yet,
+        // so we assume there's no title bar.
+        return {};
     }
-    if (data.minimizeButton && data.minimizeButton->isVisible() && data.minimizeButton->isEnabled()) {
-        if (mapItemGeometryToScene(data.minimizeButton).contains(pos)) {
-            *button = QuickGlobal::SystemButtonType::Minimize;
-            return true;
-        }
+    const QMutexLocker locker(&g_quickHelper()->mutex);
+    QuickHelperData * const data = getWindowDataMutable();
+    if (!data) {
+        return {};
     }
-    if (data.maximizeButton && data.maximizeButton->isVisible() && data.maximizeButton->isEnabled()) {
-        if (mapItemGeometryToScene(data.maximizeButton).contains(pos)) {
-            *button = QuickGlobal::SystemButtonType::Maximize;
-            return true;
-        }
+    // Mapping all the tracked items to the scene is expensive and WM_NCHITTEST alone asks
+    // several times for each mouse move, so we only do it after one of them has changed.
+    if (data->hitTestGeometryDirty) {
+        data->hitTestGeometryDirty = false;
+        data->hitTestGeometry = calculateHitTestGeometry(*data);
     }
-    if (data.closeButton && data.closeButton->isVisible() && data.closeButton->isEnabled()) {
-        if (mapItemGeometryToScene(data.closeButton).contains(pos)) {
-            *button = QuickGlobal::SystemButtonType::Close;
-            return true;
-        }
-    }
-    return false;
+    return Utils::classifyHitTestZone(data->hitTestGeometry, pos, resizable);
 }
 
-bool FramelessQuickHelperPrivate::isInTitleBarDraggableArea(const QPoint &pos) const
+HitTestGeometry FramelessQuickHelperPrivate::calculateHitTestGeometry(const QuickHelperData &data) const
 {
-    const QuickHelperData data = getWindowData();
+    Q_Q(const FramelessQuickHelper);
+    const QQuickWindow * const window = q->window();
+    if (!window) {
+        return {};
+    }
+    HitTestGeometry geometry = {};
+    geometry.windowSize = window->size();
+    const std::pair<SystemButtonType, QQuickItem *> systemButtons[] = {
+        {SystemButtonType::WindowIcon, data.windowIconButton},
+        {SystemButtonType::Help, data.contextHelpButton},
+        {SystemButtonType::Minimize, data.minimizeButton},
+        {SystemButtonType::Maximize, data.maximizeButton},
+        {SystemButtonType::Close, data.closeButton}
+    };
+    for (auto &&button : std::as_const(systemButtons)) {
+        if (button.second && button.second->isVisible() && button.second->isEnabled()) {
+            geometry.systemButtons.append({button.first, mapItemGeometryToScene(button.second)});
+        }
+    }
     if (!data.titleBarItem) {
         // There's no title bar at all, the mouse will always be in the client area.
-        return false;
+        return geometry;
     }
     if (!data.titleBarItem->isVisible() || !data.titleBarItem->isEnabled()) {
         // The title bar is hidden or disabled for some reason, treat it as there's no title bar.
-        return false;
+        return geometry;
     }
-    Q_Q(const FramelessQuickHelper);
-    const QQuickWindow * const window = q->window();
-    if (!window) {
-        // The FramelessQuickHelper item has not been attached to a specific window yet,
-        // so we assume there's no title bar.
-        return false;
-    }
-    const QRect windowRect = {QPoint(0, 0), window->size()};
+    const QRect windowRect = {QPoint(0, 0), geometry.windowSize};
     const QRect titleBarRect = mapItemGeometryToScene(data.titleBarItem);
     if (!titleBarRect.intersects(windowRect)) {
         // The title bar is totally outside of the window for some reason,
         // also treat it as there's no title bar.
-        return false;
-    }
-    QRegion region = titleBarRect;
-    const auto systemButtons = {data.windowIconButton, data.contextHelpButton,
-                     data.minimizeButton, data.maximizeButton, data.closeButton};
-    for (auto &&button : std::as_const(systemButtons)) {
-        if (button && button->isVisible() && button->isEnabled()) {
-            region -= mapItemGeometryToScene(button);
-        }
+        return geometry;
     }
+    geometry.titleBarRect = titleBarRect;
     if (!data.hitTestVisibleItems.isEmpty()) {
         for (auto &&item : std::as_const(data.hitTestVisibleItems)) {
             if (item && item->isVisible() && item->isEnabled()) {
-                region -= mapItemGeometryToScene(item);
+                geometry.hitTestVisibleRects.append(mapItemGeometryToScene(item));
             }
         }
     }
     if (!data.hitTestVisibleRects.isEmpty()) {
         for (auto &&rect : std::as_const(data.hitTestVisibleRects)) {
             if (rect.isValid()) {
-                region -= rect;
+                geometry.hitTestVisibleRects.append(rect);
             }
         }
     }
-    return region.contains(pos);
+    return geometry;
+}
+
+void FramelessQuickHelperPrivate::trackItemGeometry(QQuickItem *item)
+{
+    Q_ASSERT(item);
+    if (!item) {
+        return;
+    }
+    // The scene geometry of an item also depends on all of its ancestors, so we have
+    // to watch the whole parent chain, not only the item itself.
+    for (QQuickItem *i = item; i; i = i->parentItem()) {
+        connect(i, &QQuickItem::xChanged, this,
+            &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+        connect(i, &QQuickItem::yChanged, this,
+            &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+        connect(i, &QQuickItem::widthChanged, this,
+            &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+        connect(i, &QQuickItem::heightChanged, this,
+            &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+        connect(i, &QQuickItem::visibleChanged, this,
+            &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+        connect(i, &QQuickItem::enabledChanged, this,
+            &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+        // Start watching the new ancestors as well.
+        connect(i, &QQuickItem::parentChanged, this,
+            &FramelessQuickHelperPrivate::handleItemParentChanged, Qt::UniqueConnection);
+    }
+    connect(item, &QObject::destroyed, this,
+        &FramelessQuickHelperPrivate::invalidateHitTestGeometry, Qt::UniqueConnection);
+}
+
+void FramelessQuickHelperPrivate::handleItemParentChanged(QQuickItem *parent)
+{
+    if (parent) {
+        trackItemGeometry(parent);
+    }
+    invalidateHitTestGeometry();
+}
+
+void FramelessQuickHelperPrivate::invalidateHitTestGeometry()
+{
+    Q_Q(const FramelessQuickHelper);
+    if (!q->window()) {
+        return;
+    }
+    const QMutexLocker locker(&g_quickHelper()->mutex);
+    if (QuickHelperData * const data = getWindowDataMutable()) {
+        data->hitTestGeometryDirty = true;
+    }
 }
 
 bool FramelessQuickHelperPrivate::shouldIgnoreMouseEvents(const QPoint &pos) const
@@ -25,15 +25,23 @@
 #include "quickmicamaterial.h"
 #include "quickmicamaterial_p.h"
 #include <micamaterial.h>
+#include <micamaterial_p.h>
 #include <QtCore/qmutex.h>
+#include <QtCore/qhash.h>
 #include <QtGui/qscreen.h>
+#include <QtGui/qimage.h>
 #include <QtGui/qpainter.h>
 #include <QtGui/qguiapplication.h>
 #include <QtQuick/qquickwindow.h>
 #include <QtQuick/qsgsimpletexturenode.h>
+#include <QtQuick/qsgrendererinterface.h>
+#include <QtQuick/qsgtexture.h>
 #ifndef FRAMELESSHELPER_QUICK_NO_PRIVATE
 #  include <QtQuick/private/qquickitem_p.h>
 #endif // FRAMELESSHELPER_QUICK_NO_PRIVATE
+#include <atomic>
+#include <memory>
+#include <utility>
 
 FRAMELESSHELPER_BEGIN_NAMESPACE
 
@@ -53,13 +61,84 @@ Q_LOGGING_CATEGORY(lcQuickMicaMaterial, "wangwenx190.framelesshelper.quick.quick
 
 using namespace Global;
 
+// The mica material of the screens that show at least one item. All items share the same
+// images, and all the nodes that render with the same graphics device share the same
+// textures, each of them just samples a different part of them.
 struct QuickMicaData
 {
+    struct ScreenImage
+    {
+        QImage image = {}; // Null once trimmed, until it's painted again.
+        QRect geometry = {};
+        quint64 serial = 0;
+    };
+    struct SharedTexture
+    {
+        quint64 serial = 0;
+        std::weak_ptr<QSGTexture> texture = {};
+    };
     QMutex mutex;
+    MicaMaterial *micaMaterial = nullptr; // Lives in the GUI thread.
+    QList<QuickMicaMaterialPrivate *> items = {};
+    QHash<QScreen *, ScreenImage> screenImages = {};
+    // Bumped whenever any of "screenImages" changes, the new value becomes the serial of the
+    // changed images. Only written with the lock held, but read without it to keep syncs cheap.
+    std::atomic<quint64> wallpaperSerial = 0;
+    QHash<QPair<const void *, QScreen *>, SharedTexture> textures = {};
+    // Only touched in the GUI thread.
+    bool regenerationPending = false;
+    bool repaintAllScreens = false;
 };
 
 Q_GLOBAL_STATIC(QuickMicaData, g_data)
 
+// Textures can only be shared between the windows that render with the same graphics device.
+[[nodiscard]] static inline const void *graphicsDeviceOf(QQuickWindow *window)
+{
+    Q_ASSERT(window);
+    if (!window) {
+        return nullptr;
+    }
+    const void *device = nullptr;
+    if (QSGRendererInterface * const rif = window->rendererInterface()) {
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+        device = rif->getResource(window, QSGRendererInterface::RhiResource);
+#else
+        device = rif->getResource(window, QSGRendererInterface::OpenGLContextResource);
+#endif
+    }
+    // The software backend has nothing to share.
+    return (device ? device : window);
+}
+
+[[nodiscard]] static inline QRectF globalGeometryOf(const QQuickItem *item)
+{
+    Q_ASSERT(item);
+    if (!item) {
+        return {};
+    }
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
+    const QSizeF size = item->size();
+#else
+    const QSizeF size = {item->width(), item->height()};
+#endif
+    return {item->mapToGlobal(QPointF(0.0, 0.0)), size};
+}
+
+// The caller must hold the lock. Nobody uses the textures of these entries anymore, and
+// their graphics device may be gone already, so its address may be reused by a new one.
+static inline void pruneSharedTextures()
+{
+    QHash<QPair<const void *, QScreen *>, QuickMicaData::SharedTexture> &textures = g_data()->textures;
+    for (auto it = textures.begin(); it != textures.end();) {
+        if (it->texture.expired()) {
+            it = textures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 class WallpaperImageNode : public QObject, public QSGTransformNode
 {
     Q_OBJECT
@@ -69,19 +148,29 @@ public:
     explicit WallpaperImageNode(QuickMicaMaterial *item);
     ~WallpaperImageNode() override;
 
-public Q_SLOTS:
-    void maybeUpdateWallpaperImageClipRect();
-    void maybeGenerateWallpaperImageCache(const bool force = false);
+    // Only called from QuickMicaMaterial::updatePaintNode(), in the render thread while
+    // the GUI thread is blocked, so the node's own state needs no locking at all.
+    void synchronize();
 
 private:
-    void initialize();
+    // One child node for each screen the item is shown on.
+    struct ScreenNode
+    {
+        QSGSimpleTextureNode *node = nullptr;
+        std::shared_ptr<QSGTexture> texture = nullptr;
+        quint64 serial = 0;
+        QRect geometry = {};
+    };
+
+    void removeScreenNode(QScreen *screen);
 
 private:
-    QSGTexture *m_texture = nullptr;
+    QHash<QScreen *, ScreenNode> m_screenNodes = {};
+    quint64 m_wallpaperSerial = 0;
+    QRectF m_itemGlobalGeometry = {};
+    bool m_visible = false;
+    bool m_dirty = true;
     QPointer<QuickMicaMaterial> m_item = nullptr;
-    QSGSimpleTextureNode *m_node = nullptr;
-    QPixmap m_pixmapCache = {};
-    MicaMaterial *m_micaMaterial = nullptr;
 };
 
 WallpaperImageNode::WallpaperImageNode(QuickMicaMaterial *item)
@@ -91,67 +180,152 @@ WallpaperImageNode::WallpaperImageNode(QuickMicaMaterial *item)
         return;
     }
     m_item = item;
-    initialize();
+    synchronize();
 }
 
-WallpaperImageNode::~WallpaperImageNode() = default;
-
-void WallpaperImageNode::initialize()
+WallpaperImageNode::~WallpaperImageNode()
 {
-    g_data()->mutex.lock();
-
-    QQuickWindow * const window = m_item->window();
-    m_micaMaterial = new MicaMaterial(this);
-
-    m_node = new QSGSimpleTextureNode;
-    m_node->setFiltering(QSGTexture::Linear);
-
-    g_data()->mutex.unlock();
-
-    maybeGenerateWallpaperImageCache();
-    maybeUpdateWallpaperImageClipRect();
-
-    appendChildNode(m_node);
-
-    connect(m_micaMaterial, &MicaMaterial::shouldRedraw, this, [this](){
-        maybeGenerateWallpaperImageCache(true);
-    });
-    connect(window, &QQuickWindow::beforeRendering, this,
-        &WallpaperImageNode::maybeUpdateWallpaperImageClipRect, Qt::DirectConnection);
-
-    QuickMicaMaterialPrivate::get(m_item)->appendNode(this);
+    // The nodes go away together with the scene graph, and so do the textures
+    // of its graphics device, once the last node that uses them lets go of them.
+    // The child nodes are owned by us and deleted by QSGNode.
+    m_screenNodes.clear();
+    if (g_data.isDestroyed()) {
+        return;
+    }
+    const QMutexLocker locker(&g_data()->mutex);
+    pruneSharedTextures();
 }
 
-void WallpaperImageNode::maybeGenerateWallpaperImageCache(const bool force)
+void WallpaperImageNode::removeScreenNode(QScreen *screen)
 {
-    const QMutexLocker locker(&g_data()->mutex);
-    if (!m_pixmapCache.isNull() && !force) {
+    const auto it = m_screenNodes.find(screen);
+    if (it == m_screenNodes.end()) {
         return;
     }
-    const QSize desktopSize = QGuiApplication::primaryScreen()->virtualSize();
-    static constexpr const QPoint originPoint = {0, 0};
-    m_pixmapCache = QPixmap(desktopSize);
-    m_pixmapCache.fill(kDefaultTransparentColor);
-    QPainter painter(&m_pixmapCache);
-    m_micaMaterial->paint(&painter, desktopSize, originPoint);
-    if (m_texture) {
-        delete m_texture;
-        m_texture = nullptr;
-    }
-    m_texture = m_item->window()->createTextureFromImage(m_pixmapCache.toImage());
-    m_node->setTexture(m_texture);
+    removeChildNode(it->node);
+    delete it->node;
+    m_screenNodes.erase(it);
 }
 
-void WallpaperImageNode::maybeUpdateWallpaperImageClipRect()
+void WallpaperImageNode::synchronize()
 {
-    const QMutexLocker locker(&g_data()->mutex);
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 10, 0))
-    const QSizeF itemSize = m_item->size();
-#else
-    const QSizeF itemSize = {m_item->width(), m_item->height()};
-#endif
-    m_node->setRect(QRectF(QPointF(0.0, 0.0), itemSize));
-    m_node->setSourceRect(QRectF(m_item->mapToGlobal(QPointF(0.0, 0.0)), itemSize));
+    if (!m_item) {
+        return;
+    }
+    const QRectF itemGeometry = globalGeometryOf(m_item);
+    const bool visible = m_item->isVisible();
+    const quint64 wallpaperSerial = g_data()->wallpaperSerial;
+    if (!m_dirty && (m_wallpaperSerial == wallpaperSerial)
+        && (m_itemGlobalGeometry == itemGeometry) && (m_visible == visible)) {
+        return;
+    }
+    m_dirty = false;
+    m_wallpaperSerial = wallpaperSerial;
+    m_itemGlobalGeometry = itemGeometry;
+    m_visible = visible;
+    QQuickWindow * const window = m_item->window();
+    const void * const device = graphicsDeviceOf(window);
+    struct Pending
+    {
+        QScreen *screen = nullptr;
+        QImage image = {};
+        QRect geometry = {};
+        quint64 serial = 0;
+        std::shared_ptr<QSGTexture> texture = nullptr;
+    };
+    QList<Pending> pending = {};
+    bool imagesMissing = false;
+    // A hidden item doesn't hold on to any texture.
+    if (visible) {
+        const QMutexLocker locker(&g_data()->mutex);
+        for (auto it = g_data()->screenImages.cbegin(); it != g_data()->screenImages.cend(); ++it) {
+            if (!itemGeometry.intersects(QRectF(it->geometry))) {
+                continue;
+            }
+            Pending entry = {};
+            entry.screen = it.key();
+            entry.geometry = it->geometry;
+            entry.serial = it->serial;
+            const auto current = std::as_const(m_screenNodes).find(it.key());
+            if ((current != m_screenNodes.cend()) && (current->serial == it->serial)) {
+                entry.texture = current->texture;
+            } else {
+                const auto shared = std::as_const(g_data()->textures).find(qMakePair(device, it.key()));
+                if ((shared != g_data()->textures.cend()) && (shared->serial == it->serial)) {
+                    entry.texture = shared->texture.lock();
+                }
+                if (!entry.texture) {
+                    if (it->image.isNull()) {
+                        // The image has been trimmed, keep showing what we have until it's back.
+                        imagesMissing = true;
+                        if (current == m_screenNodes.cend()) {
+                            continue;
+                        }
+                        entry.serial = current->serial;
+                        entry.texture = current->texture;
+                    } else {
+                        // Only the handle is copied, the pixels are still shared.
+                        entry.image = it->image;
+                    }
+                }
+            }
+            pending.append(entry);
+        }
+        if (imagesMissing && g_data()->micaMaterial) {
+            QMetaObject::invokeMethod(g_data()->micaMaterial, [](){
+                QuickMicaMaterialPrivate::scheduleWallpaperImagesRegeneration(false);
+            }, Qt::QueuedConnection);
+        }
+    }
+    for (auto &&entry : pending) {
+        if (entry.texture) {
+            continue;
+        }
+        // The first node that notices the change uploads the new image, the others reuse it.
+        // The old texture stays alive until the last node that still uses it lets go of it.
+        // Uploading takes a while, so it's done without the lock, the other render threads
+        // shouldn't have to wait for it. If two of them race, the first texture published wins.
+        auto uploaded = std::shared_ptr<QSGTexture>(window->createTextureFromImage(entry.image));
+        const QMutexLocker locker(&g_data()->mutex);
+        pruneSharedTextures();
+        QuickMicaData::SharedTexture &shared = g_data()->textures[qMakePair(device, entry.screen)];
+        std::shared_ptr<QSGTexture> published = shared.texture.lock();
+        if (published && (shared.serial == entry.serial)) {
+            entry.texture = std::move(published);
+        } else {
+            // Don't replace a texture of a newer image that has been published meanwhile.
+            if (!published || (shared.serial < entry.serial)) {
+                shared.serial = entry.serial;
+                shared.texture = uploaded;
+            }
+            entry.texture = std::move(uploaded);
+        }
+    }
+    QList<QScreen *> shownScreens = {};
+    for (auto &&entry : std::as_const(pending)) {
+        shownScreens.append(entry.screen);
+        ScreenNode &screenNode = m_screenNodes[entry.screen];
+        if (!screenNode.node) {
+            screenNode.node = new QSGSimpleTextureNode;
+            screenNode.node->setFiltering(QSGTexture::Linear);
+            appendChildNode(screenNode.node);
+        }
+        if (screenNode.texture != entry.texture) {
+            screenNode.texture = entry.texture;
+            screenNode.node->setTexture(screenNode.texture.get());
+        }
+        screenNode.serial = entry.serial;
+        screenNode.geometry = entry.geometry;
+        // Each child only covers the part of the item that is on its screen.
+        const QRectF visibleRect = itemGeometry.intersected(QRectF(entry.geometry));
+        screenNode.node->setRect(visibleRect.translated(-itemGeometry.topLeft()));
+        screenNode.node->setSourceRect(visibleRect.translated(-QPointF(entry.geometry.topLeft())));
+    }
+    for (auto &&screen : m_screenNodes.keys()) {
+        if (!shownScreens.contains(screen)) {
+            removeScreenNode(screen);
+        }
+    }
 }
 
 QuickMicaMaterialPrivate::QuickMicaMaterialPrivate(QuickMicaMaterial *q) : QObject(q)
@@ -164,7 +338,28 @@ QuickMicaMaterialPrivate::QuickMicaMaterialPrivate(QuickMicaMaterial *q) : QObje
     initialize();
 }
 
-QuickMicaMaterialPrivate::~QuickMicaMaterialPrivate() = default;
+QuickMicaMaterialPrivate::~QuickMicaMaterialPrivate()
+{
+    MicaMaterial *micaMaterial = nullptr;
+    {
+        const QMutexLocker locker(&g_data()->mutex);
+        g_data()->items.removeAll(this);
+        if (g_data()->items.isEmpty()) {
+            // The textures go away together with the last nodes that use them.
+            micaMaterial = std::exchange(g_data()->micaMaterial, nullptr);
+            g_data()->screenImages.clear();
+        }
+    }
+    if (!micaMaterial) {
+        // The screens that only showed this item don't need their images any more.
+        scheduleWallpaperImagesRegeneration(false);
+        return;
+    }
+    // The pending regeneration goes away together with the material.
+    g_data()->regenerationPending = false;
+    g_data()->repaintAllScreens = false;
+    delete micaMaterial;
+}
 
 QuickMicaMaterialPrivate *QuickMicaMaterialPrivate::get(QuickMicaMaterial *q)
 {
@@ -191,6 +386,165 @@ void QuickMicaMaterialPrivate::initialize()
     q->setSmooth(true);
     q->setAntialiasing(true);
     q->setClip(true);
+    // The node only re-aligns the wallpaper when it gets synchronized, which
+    // happens when the item or its window has been moved or resized. The item
+    // may have been moved onto a screen that has no image yet, and the screens
+    // of the hidden items don't need one.
+    connect(q, &QuickMicaMaterial::xChanged, this, &QuickMicaMaterialPrivate::updateScreens);
+    connect(q, &QuickMicaMaterial::yChanged, this, &QuickMicaMaterialPrivate::updateScreens);
+    connect(q, &QuickMicaMaterial::widthChanged, this, &QuickMicaMaterialPrivate::updateScreens);
+    connect(q, &QuickMicaMaterial::heightChanged, this, &QuickMicaMaterialPrivate::updateScreens);
+    connect(q, &QuickMicaMaterial::visibleChanged, this, &QuickMicaMaterialPrivate::updateScreens);
+
+    {
+        const QMutexLocker locker(&g_data()->mutex);
+        g_data()->items.append(this);
+        if (!g_data()->micaMaterial) {
+            g_data()->micaMaterial = new MicaMaterial;
+            // A new tile is published for each screen, they are all picked up at once.
+            connect(g_data()->micaMaterial, &MicaMaterial::shouldRedraw, g_data()->micaMaterial, [](){
+                scheduleWallpaperImagesRegeneration(true);
+            });
+            // The images of the screens that are gone must not stay around.
+            connect(qGuiApp, &QGuiApplication::screenRemoved, g_data()->micaMaterial, [](){
+                scheduleWallpaperImagesRegeneration(false);
+            });
+            connect(MicaMaterialPrivate::get(g_data()->micaMaterial), &MicaMaterialPrivate::cachesTrimmed,
+                g_data()->micaMaterial, &QuickMicaMaterialPrivate::trimCaches);
+        }
+    }
+    scheduleWallpaperImagesRegeneration(false);
+}
+
+void QuickMicaMaterialPrivate::updateScreens()
+{
+    Q_Q(QuickMicaMaterial);
+    q->update();
+    scheduleWallpaperImagesRegeneration(false);
+}
+
+void QuickMicaMaterialPrivate::scheduleWallpaperImagesRegeneration(const bool repaintAll)
+{
+    if (repaintAll) {
+        g_data()->repaintAllScreens = true;
+    }
+    if (g_data()->regenerationPending) {
+        return;
+    }
+    MicaMaterial * const micaMaterial = g_data()->micaMaterial;
+    if (!micaMaterial) {
+        return;
+    }
+    g_data()->regenerationPending = true;
+    // Everything that happens in the same event loop iteration is handled at once.
+    QMetaObject::invokeMethod(micaMaterial, &QuickMicaMaterialPrivate::regenerateWallpaperImages, Qt::QueuedConnection);
+}
+
+void QuickMicaMaterialPrivate::regenerateWallpaperImages()
+{
+    const bool repaintAll = std::exchange(g_data()->repaintAllScreens, false);
+    g_data()->regenerationPending = false;
+    MicaMaterial *micaMaterial = nullptr;
+    QList<QuickMicaMaterialPrivate *> items = {};
+    QHash<QScreen *, QRect> painted = {};
+    {
+        const QMutexLocker locker(&g_data()->mutex);
+        micaMaterial = g_data()->micaMaterial;
+        items = g_data()->items;
+        for (auto it = g_data()->screenImages.cbegin(); it != g_data()->screenImages.cend(); ++it) {
+            if (!it->image.isNull()) {
+                painted.insert(it.key(), it->geometry);
+            }
+        }
+    }
+    if (!micaMaterial) {
+        return;
+    }
+    // Only the screens that actually show an item are painted, so the other screens
+    // don't need a wallpaper tile either.
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    QList<QScreen *> neededScreens = {};
+    for (auto &&item : std::as_const(items)) {
+        const QuickMicaMaterial * const q = item->q_ptr;
+        if (!q->isVisible() || !q->window() || !q->window()->isVisible()) {
+            continue;
+        }
+        const QRectF itemGeometry = globalGeometryOf(q);
+        for (auto &&screen : std::as_const(screens)) {
+            if (!neededScreens.contains(screen) && itemGeometry.intersects(QRectF(screen->geometry()))) {
+                neededScreens.append(screen);
+            }
+        }
+    }
+    if (neededScreens.isEmpty()) {
+        // Nothing shows the material, so it doesn't keep the blurred wallpaper alive either.
+        // It becomes active again as soon as it's painted again.
+        MicaMaterialPrivate::get(micaMaterial)->setActive(false);
+    }
+    QHash<QScreen *, QImage> images = {};
+    for (auto &&screen : std::as_const(neededScreens)) {
+        const QRect geometry = screen->geometry();
+        if (!repaintAll && (painted.value(screen) == geometry)) {
+            continue;
+        }
+        QImage image(geometry.size(), QImage::Format_ARGB32_Premultiplied);
+        image.fill(kDefaultTransparentColor);
+        {
+            QPainter painter(&image);
+            micaMaterial->paint(&painter, geometry.size(), geometry.topLeft());
+        }
+        images.insert(screen, image);
+    }
+    const QMutexLocker locker(&g_data()->mutex);
+    bool changed = false;
+    for (auto it = g_data()->screenImages.begin(); it != g_data()->screenImages.end();) {
+        if (neededScreens.contains(it.key())) {
+            ++it;
+        } else {
+            it = g_data()->screenImages.erase(it);
+            changed = true;
+        }
+    }
+    if (!images.isEmpty()) {
+        const quint64 serial = ++g_data()->wallpaperSerial;
+        for (auto it = images.cbegin(); it != images.cend(); ++it) {
+            QuickMicaData::ScreenImage &screenImage = g_data()->screenImages[it.key()];
+            screenImage.image = it.value();
+            screenImage.geometry = it.key()->geometry();
+            screenImage.serial = serial;
+        }
+        changed = true;
+    } else if (changed) {
+        ++g_data()->wallpaperSerial;
+    }
+    if (!changed) {
+        return;
+    }
+    // Every node picks up the new textures the next time its item is synchronized.
+    for (auto &&item : std::as_const(g_data()->items)) {
+        item->q_ptr->update();
+    }
+}
+
+void QuickMicaMaterialPrivate::trimCaches(const CacheTrimLevel level)
+{
+    {
+        const QMutexLocker locker(&g_data()->mutex);
+        pruneSharedTextures();
+        if (level == CacheTrimLevel::Unused) {
+            // The images of the screens without a visible item are gone already.
+            return;
+        }
+        // The nodes have uploaded them already, they are painted again once a node needs them.
+        for (auto &&screenImage : g_data()->screenImages) {
+            screenImage.image = {};
+        }
+        // Makes the nodes look at their textures again, the hidden ones let go of theirs.
+        ++g_data()->wallpaperSerial;
+    }
+    for (auto &&item : std::as_const(g_data()->items)) {
+        item->q_ptr->update();
+    }
 }
 
 void QuickMicaMaterialPrivate::rebindWindow()
@@ -215,32 +569,18 @@ void QuickMicaMaterialPrivate::rebindWindow()
         disconnect(m_rootWindowYChangedConnection);
         m_rootWindowYChangedConnection = {};
     }
-    m_rootWindowXChangedConnection = connect(window, &QQuickWindow::xChanged, q, [q](){ q->update(); });
-    m_rootWindowYChangedConnection = connect(window, &QQuickWindow::yChanged, q, [q](){ q->update(); });
-}
-
-void QuickMicaMaterialPrivate::forceRegenerateWallpaperImageCache()
-{
-    if (m_nodes.isEmpty()) {
-        return;
-    }
-    for (auto &&node : std::as_const(m_nodes)) {
-        if (node) {
-            node->maybeGenerateWallpaperImageCache(true);
-        }
+    if (m_rootWindowVisibleChangedConnection) {
+        disconnect(m_rootWindowVisibleChangedConnection);
+        m_rootWindowVisibleChangedConnection = {};
     }
+    m_rootWindowXChangedConnection = connect(window, &QQuickWindow::xChanged, this, &QuickMicaMaterialPrivate::updateScreens);
+    m_rootWindowYChangedConnection = connect(window, &QQuickWindow::yChanged, this, &QuickMicaMaterialPrivate::updateScreens);
+    m_rootWindowVisibleChangedConnection = connect(window, &QQuickWindow::visibleChanged, this, &QuickMicaMaterialPrivate::updateScreens);
 }
 
-void QuickMicaMaterialPrivate::appendNode(WallpaperImageNode *node)
+void QuickMicaMaterialPrivate::forceRegenerateWallpaperImageCache()
 {
-    Q_ASSERT(node);
-    if (!node) {
-        return;
-    }
-    if (m_nodes.contains(node)) {
-        return;
-    }
-    m_nodes.append(node);
+    scheduleWallpaperImagesRegeneration(true);
 }
 
 QuickMicaMaterial::QuickMicaMaterial(QQuickItem *parent)
@@ -273,7 +613,9 @@ QSGNode *QuickMicaMaterial::updatePaintNode(QSGNode *old, UpdatePaintNodeData *d
 {
     Q_UNUSED(data);
     auto node = static_cast<WallpaperImageNode *>(old);
-    if (!node) {
+    if (node) {
+        node->synchronize();
+    } else {
         node = new WallpaperImageNode(this);
     }
     return node;
@@ -40,6 +40,8 @@
 #include <framelessmanager.h>
 #include <framelessconfig_p.h>
 #include <utils.h>
+#include <atomic>
+#include <memory>
 
 #ifndef QWIDGETSIZE_MAX
 #  define QWIDGETSIZE_MAX ((1 << 24) - 1)
@@ -66,7 +68,6 @@ using namespace Global;
 struct WidgetsHelperData
 {
     bool ready = false;
-    SystemParameters params = {};
     QPointer<QWidget> titleBarWidget = nullptr;
     QList<QPointer<QWidget>> hitTestVisibleWidgets = {};
     QPointer<QWidget> windowIconButton = nullptr;
@@ -77,14 +78,215 @@ struct WidgetsHelperData
     QList<QRect> hitTestVisibleRects = {};
 };
 
+using WidgetsHelperDataPtr = std::shared_ptr<const WidgetsHelperData>;
+
+// The hit-test callbacks are the readers and run on the GUI thread, but the setters are
+// public API and may be called from any thread, so the snapshot is published atomically.
+// Everything goes through the two helpers below: the free std::atomic_load/store() overloads
+// for std::shared_ptr are deprecated since C++20, where std::atomic<std::shared_ptr> replaces them.
+#ifdef __cpp_lib_atomic_shared_ptr
+using WidgetsHelperDataSnapshot = std::atomic<WidgetsHelperDataPtr>;
+#else
+using WidgetsHelperDataSnapshot = WidgetsHelperDataPtr;
+#endif
+
+[[nodiscard]] static inline WidgetsHelperDataPtr loadSnapshot(const WidgetsHelperDataSnapshot &snapshot)
+{
+#ifdef __cpp_lib_atomic_shared_ptr
+    return snapshot.load(std::memory_order_acquire);
+#else
+    return std::atomic_load_explicit(&snapshot, std::memory_order_acquire);
+#endif
+}
+
+static inline void storeSnapshot(WidgetsHelperDataSnapshot &snapshot, WidgetsHelperDataPtr value)
+{
+#ifdef __cpp_lib_atomic_shared_ptr
+    snapshot.store(std::move(value), std::memory_order_release);
+#else
+    std::atomic_store_explicit(&snapshot, std::move(value), std::memory_order_release);
+#endif
+}
+
+struct WidgetsHelperWindowData;
+
+// Invalidates the cached hit-test geometry of a window whenever one of its tracked widgets,
+// or one of their ancestors, changes. It belongs to the window's data rather than to the
+// helper that registered the widgets, so they stay tracked for as long as the window is,
+// even if that helper is destroyed before the others.
+class HitTestGeometryWatcher final : public QObject
+{
+    Q_DISABLE_COPY_MOVE(HitTestGeometryWatcher)
+
+public:
+    explicit HitTestGeometryWatcher(WidgetsHelperWindowData *windowData) : m_windowData(windowData)
+    {
+        Q_ASSERT(m_windowData);
+    }
+
+    ~HitTestGeometryWatcher() override = default;
+
+    void track(QWidget *widget);
+
+protected:
+    Q_NODISCARD bool eventFilter(QObject *object, QEvent *event) override;
+
+private:
+    void invalidate();
+
+private:
+    WidgetsHelperWindowData *m_windowData = nullptr;
+};
+
+struct WidgetsHelperWindowData
+{
+    // Only serializes the writers, the readers never touch it.
+    QMutex mutex;
+    // Immutable snapshot, see loadSnapshot() and storeSnapshot(). The writers
+    // always make a modified copy and swap it in as a whole.
+    WidgetsHelperDataSnapshot snapshot{std::make_shared<const WidgetsHelperData>()};
+    // The following members are only accessed from the GUI thread.
+    HitTestGeometry hitTestGeometry = {};
+    bool hitTestGeometryDirty = true;
+    const std::unique_ptr<HitTestGeometryWatcher> geometryWatcher = std::make_unique<HitTestGeometryWatcher>(this);
+};
+
+void HitTestGeometryWatcher::track(QWidget *widget)
+{
+    Q_ASSERT(widget);
+    if (!widget) {
+        return;
+    }
+    // The scene geometry of a widget also depends on all of its ancestors, so we have
+    // to watch the whole parent chain, not only the widget itself. Installing the same
+    // event filter more than once is fine, Qt will only keep one of them.
+    for (QWidget *w = widget; w; w = w->parentWidget()) {
+        w->installEventFilter(this);
+        if (w->isWindow()) {
+            break;
+        }
+    }
+    connect(widget, &QObject::destroyed, this, &HitTestGeometryWatcher::invalidate, Qt::UniqueConnection);
+}
+
+void HitTestGeometryWatcher::invalidate()
+{
+    m_windowData->hitTestGeometryDirty = true;
+}
+
+bool HitTestGeometryWatcher::eventFilter(QObject *object, QEvent *event)
+{
+    Q_ASSERT(object);
+    Q_ASSERT(event);
+    if (!object || !event) {
+        return false;
+    }
+    if (!object->isWidgetType()) {
+        return QObject::eventFilter(object, event);
+    }
+    switch (event->type()) {
+    case QEvent::Move:
+        // Everything is in window coordinates, moving the window itself changes nothing.
+        if (static_cast<QWidget *>(object)->isWindow()) {
+            break;
+        }
+        invalidate();
+        break;
+    case QEvent::ParentChange:
+        // Start watching the new ancestors as well.
+        track(static_cast<QWidget *>(object));
+        invalidate();
+        break;
+    case QEvent::Resize:
+    case QEvent::Show:
+    case QEvent::Hide:
+    case QEvent::EnabledChange:
+        invalidate();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(object, event);
+}
+
 struct WidgetsHelper
 {
     QMutex mutex;
-    QHash<WId, WidgetsHelperData> data = {};
+    QHash<WId, std::shared_ptr<WidgetsHelperWindowData>> data = {};
 };
 
 Q_GLOBAL_STATIC(WidgetsHelper, g_widgetsHelper)
 
+class WidgetsWindowAdapter final : public WindowAdapter
+{
+    Q_DISABLE_COPY_MOVE(WidgetsWindowAdapter)
+
+public:
+    explicit WidgetsWindowAdapter(FramelessWidgetsHelperPrivate *priv, QWidget *window) : m_priv(priv), m_window(window)
+    {
+        Q_ASSERT(m_priv);
+        Q_ASSERT(m_window);
+    }
+
+    ~WidgetsWindowAdapter() override = default;
+
+    Q_NODISCARD Qt::WindowFlags getWindowFlags() const override { return m_window->windowFlags(); }
+    void setWindowFlags(const Qt::WindowFlags flags) override { m_window->setWindowFlags(flags); }
+    Q_NODISCARD QSize getWindowSize() const override { return m_window->size(); }
+    void setWindowSize(const QSize &size) override { m_window->resize(size); }
+    Q_NODISCARD QPoint getWindowPosition() const override { return m_window->pos(); }
+    void setWindowPosition(const QPoint &pos) override { m_window->move(pos); }
+    Q_NODISCARD QScreen *getWindowScreen() const override
+    {
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
+        return m_window->screen();
+#else
+        return m_window->windowHandle()->screen();
+#endif
+    }
+    Q_NODISCARD bool isWindowFixedSize() const override { return m_priv->isWindowFixedSize(); }
+    void setWindowFixedSize(const bool value) override { m_priv->setWindowFixedSize(value); }
+    Q_NODISCARD Qt::WindowState getWindowState() const override { return Utils::windowStatesToWindowState(m_window->windowState()); }
+    void setWindowState(const Qt::WindowState state) override { m_window->setWindowState(state); }
+    Q_NODISCARD QWindow *getWindowHandle() const override { return m_window->windowHandle(); }
+    Q_NODISCARD QPoint windowToScreen(const QPoint &pos) const override { return m_window->mapToGlobal(pos); }
+    Q_NODISCARD QPoint screenToWindow(const QPoint &pos) const override { return m_window->mapFromGlobal(pos); }
+    Q_NODISCARD bool isInsideSystemButtons(const QPoint &pos, SystemButtonType *button) const override { return m_priv->isInSystemButtons(pos, button); }
+    Q_NODISCARD bool isInsideTitleBarDraggableArea(const QPoint &pos) const override { return m_priv->isInTitleBarDraggableArea(pos); }
+    Q_NODISCARD qreal getWindowDevicePixelRatio() const override { return m_window->devicePixelRatioF(); }
+    void setSystemButtonState(const SystemButtonType button, const ButtonState state) override { m_priv->setSystemButtonState(button, state); }
+    Q_NODISCARD WId getWindowId() const override { return m_window->winId(); }
+    Q_NODISCARD bool shouldIgnoreMouseEvents(const QPoint &pos) const override { return m_priv->shouldIgnoreMouseEvents(pos); }
+    void showSystemMenu(const QPoint &pos) override { m_priv->showSystemMenu(pos); }
+    void setProperty(const QByteArray &name, const QVariant &value) override { m_priv->setProperty(name, value); }
+    Q_NODISCARD QVariant getProperty(const QByteArray &name, const QVariant &defaultValue) const override { return m_priv->getProperty(name, defaultValue); }
+    void setCursor(const QCursor &cursor) override { m_window->setCursor(cursor); }
+    void unsetCursor() override { m_window->unsetCursor(); }
+    Q_NODISCARD QObject *getWidgetHandle() const override { return m_window; }
+    Q_NODISCARD HitTestResult classify(const QPoint &pos) const override { return m_priv->classify(pos); }
+
+private:
+    FramelessWidgetsHelperPrivate *m_priv = nullptr;
+    QWidget *m_window = nullptr;
+};
+
+template<typename Modifier>
+static inline void modifyWindowData(WidgetsHelperWindowData * const windowData, Modifier &&modifier)
+{
+    Q_ASSERT(windowData);
+    if (!windowData) {
+        return;
+    }
+    const QMutexLocker locker(&windowData->mutex);
+    auto data = std::make_shared<WidgetsHelperData>(*loadSnapshot(windowData->snapshot));
+    // The modifier returns false if nothing has been changed.
+    if (!std::forward<Modifier>(modifier)(*data)) {
+        return;
+    }
+    storeSnapshot(windowData->snapshot, WidgetsHelperDataPtr(std::move(data)));
+    windowData->hitTestGeometryDirty = true;
+}
+
 FramelessWidgetsHelperPrivate::FramelessWidgetsHelperPrivate(FramelessWidgetsHelper *q) : QObject(q)
 {
     Q_ASSERT(q);
@@ -323,7 +525,7 @@ FramelessWidgetsHelper *FramelessWidgetsHelperPrivate::findOrCreateFramelessHelp
 
 bool FramelessWidgetsHelperPrivate::isContentExtendedIntoTitleBar() const
 {
-    return getWindowData().ready;
+    return getWindowData()->ready;
 }
 
 void FramelessWidgetsHelperPrivate::setTitleBarWidget(QWidget *widget)
@@ -332,21 +534,29 @@ void FramelessWidgetsHelperPrivate::setTitleBarWidget(QWidget *widget)
     if (!widget) {
         return;
     }
-    const QMutexLocker locker(&g_widgetsHelper()->mutex);
-    WidgetsHelperData *data = getWindowDataMutable();
-    if (!data) {
+    WidgetsHelperWindowData * const windowData = currentWindowData(true);
+    if (!windowData) {
         return;
     }
-    if (data->titleBarWidget == widget) {
+    bool changed = false;
+    modifyWindowData(windowData, [widget, &changed](WidgetsHelperData &data) -> bool {
+        if (data.titleBarWidget == widget) {
+            return false;
+        }
+        data.titleBarWidget = widget;
+        changed = true;
+        return true;
+    });
+    if (!changed) {
         return;
     }
-    data->titleBarWidget = widget;
+    trackWidgetGeometry(widget);
     emitSignalForAllInstances(FRAMELESSHELPER_BYTEARRAY_LITERAL("titleBarWidgetChanged"));
 }
 
 QWidget *FramelessWidgetsHelperPrivate::getTitleBarWidget() const
 {
-    return getWindowData().titleBarWidget;
+    return getWindowData()->titleBarWidget;
 }
 
 void FramelessWidgetsHelperPrivate::setHitTestVisible(QWidget *widget, const bool visible)
@@ -355,17 +565,24 @@ void FramelessWidgetsHelperPrivate::setHitTestVisible(QWidget *widget, const boo
     if (!widget) {
         return;
     }
-    const QMutexLocker locker(&g_widgetsHelper()->mutex);
-    WidgetsHelperData *data = getWindowDataMutable();
-    if (!data) {
+    WidgetsHelperWindowData * const windowData = currentWindowData(true);
+    if (!windowData) {
         return;
     }
-    const bool exists = data->hitTestVisibleWidgets.contains(widget);
-    if (visible && !exists) {
-        data->hitTestVisibleWidgets.append(widget);
-    }
-    if (!visible && exists) {
-        data->hitTestVisibleWidgets.removeAll(widget);
+    modifyWindowData(windowData, [widget, visible](WidgetsHelperData &data) -> bool {
+        const bool exists = data.hitTestVisibleWidgets.contains(widget);
+        if (visible && !exists) {
+            data.hitTestVisibleWidgets.append(widget);
+            return true;
+        }
+        if (!visible && exists) {
+            data.hitTestVisibleWidgets.removeAll(widget);
+            return true;
+        }
+        return false;
+    });
+    if (visible) {
+        trackWidgetGeometry(widget);
     }
 }
 
@@ -375,18 +592,22 @@ void FramelessWidgetsHelperPrivate::setHitTestVisible(const QRect &rect, const b
     if (!rect.isValid()) {
         return;
     }
-    const QMutexLocker locker(&g_widgetsHelper()->mutex);
-    WidgetsHelperData *data = getWindowDataMutable();
-    if (!data) {
+    WidgetsHelperWindowData * const windowData = currentWindowData(true);
+    if (!windowData) {
         return;
     }
-    const bool exists = data->hitTestVisibleRects.contains(rect);
-    if (visible && !exists) {
-        data->hitTestVisibleRects.append(rect);
-    }
-    if (!visible && exists) {
-        data->hitTestVisibleRects.removeAll(rect);
-    }
+    modifyWindowData(windowData, [&rect, visible](WidgetsHelperData &data) -> bool {
+        const bool exists = data.hitTestVisibleRects.contains(rect);
+        if (visible && !exists) {
+            data.hitTestVisibleRects.append(rect);
+            return true;
+        }
+        if (!visible && exists) {
+            data.hitTestVisibleRects.removeAll(rect);
+            return true;
+        }
+        return false;
+    });
 }
 
 void FramelessWidgetsHelperPrivate::setHitTestVisible(QObject *object, const bool visible)
@@ -422,54 +643,21 @@ void FramelessWidgetsHelperPrivate::attach()
         window->setAttribute(Qt::WA_NativeWindow);
     }
 
-    g_widgetsHelper()->mutex.lock();
-    WidgetsHelperData * const data = getWindowDataMutable();
-    if (!data || data->ready) {
-        g_widgetsHelper()->mutex.unlock();
+    m_windowData = findOrCreateWindowData(window->winId());
+    if (getWindowData()->ready) {
         return;
     }
-    g_widgetsHelper()->mutex.unlock();
-
-    SystemParameters params = {};
-    params.getWindowId = [window]() -> WId { return window->winId(); };
-    params.getWindowFlags = [window]() -> Qt::WindowFlags { return window->windowFlags(); };
-    params.setWindowFlags = [window](const Qt::WindowFlags flags) -> void { window->setWindowFlags(flags); };
-    params.getWindowSize = [window]() -> QSize { return window->size(); };
-    params.setWindowSize = [window](const QSize &size) -> void { window->resize(size); };
-    params.getWindowPosition = [window]() -> QPoint { return window->pos(); };
-    params.setWindowPosition = [window](const QPoint &pos) -> void { window->move(pos); };
-    params.getWindowScreen = [window]() -> QScreen * {
-#if (QT_VERSION >= QT_VERSION_CHECK(5, 14, 0))
-        return window->screen();
-#else
-        return window->windowHandle()->screen();
-#endif
-    };
-    params.isWindowFixedSize = [this]() -> bool { return isWindowFixedSize(); };
-    params.setWindowFixedSize = [this](const bool value) -> void { setWindowFixedSize(value); };
-    params.getWindowState = [window]() -> Qt::WindowState { return Utils::windowStatesToWindowState(window->windowState()); };
-    params.setWindowState = [window](const Qt::WindowState state) -> void { window->setWindowState(state); };
-    params.getWindowHandle = [window]() -> QWindow * { return window->windowHandle(); };
-    params.windowToScreen = [window](const QPoint &pos) -> QPoint { return window->mapToGlobal(pos); };
-    params.screenToWindow = [window](const QPoint &pos) -> QPoint { return window->mapFromGlobal(pos); };
-    params.isInsideSystemButtons = [this](const QPoint &pos, SystemButtonType *button) -> bool { return isInSystemButtons(pos, button); };
-    params.isInsideTitleBarDraggableArea = [this](const QPoint &pos) -> bool { return isInTitleBarDraggableArea(pos); };
-    params.getWindowDevicePixelRatio = [window]() -> qreal { return window->devicePixelRatioF(); };
-    params.setSystemButtonState = [this](const SystemButtonType button, const ButtonState state) -> void { setSystemButtonState(button, state); };
-    params.shouldIgnoreMouseEvents = [this](const QPoint &pos) -> bool { return shouldIgnoreMouseEvents(pos); };
-    params.showSystemMenu = [this](const QPoint &pos) -> void { showSystemMenu(pos); };
-    params.setProperty = [this](const QByteArray &name, const QVariant &value) -> void { setProperty(name, value); };
-    params.getProperty = [this](const QByteArray &name, const QVariant &defaultValue) -> QVariant { return getProperty(name, defaultValue); };
-    params.setCursor = [window](const QCursor &cursor) -> void { window->setCursor(cursor); };
-    params.unsetCursor = [window]() -> void { window->unsetCursor(); };
-    params.getWidgetHandle = [window]() -> QObject * { return window; };
-
-    FramelessManager::instance()->addWindow(params);
-
-    g_widgetsHelper()->mutex.lock();
-    data->params = params;
-    data->ready = true;
-    g_widgetsHelper()->mutex.unlock();
+
+    m_windowAdapter = std::make_unique<WidgetsWindowAdapter>(this, window);
+    FramelessManager::instance()->addWindow(m_windowAdapter.get());
+
+    modifyWindowData(m_windowData.get(), [](WidgetsHelperData &data) -> bool {
+        data.ready = true;
+        return true;
+    });
+
+    // The draggable area is clipped to the window rect, so a resize must invalidate it.
+    trackWidgetGeometry(window);
 
     // We have to wait for a little time before moving the top level window
     // , because the platform window may not finish initializing by the time
@@ -498,8 +686,25 @@ void FramelessWidgetsHelperPrivate::detach()
     if (!g_widgetsHelper()->data.contains(windowId)) {
         return;
     }
-    g_widgetsHelper()->data.remove(windowId);
+    // Other helper instances of the same window may still hold this object,
+    // make sure they won't see the stale registrations anymore.
+    if (const auto windowData = g_widgetsHelper()->data.take(windowId)) {
+        const QMutexLocker dataLocker(&windowData->mutex);
+        storeSnapshot(windowData->snapshot, std::make_shared<const WidgetsHelperData>());
+        windowData->hitTestGeometryDirty = true;
+        // And let them look the data up again on their next use, otherwise they
+        // would keep using this orphan after the window has been attached again.
+        const auto instances = m_window->findChildren<FramelessWidgetsHelper *>();
+        for (auto &&instance : std::as_const(instances)) {
+            FramelessWidgetsHelperPrivate * const instancePriv = get(instance);
+            if (instancePriv->m_windowData == windowData) {
+                instancePriv->m_windowData = nullptr;
+            }
+        }
+    }
+    m_windowData = nullptr;
     FramelessManager::instance()->removeWindow(windowId);
+    m_windowAdapter.reset();
     m_window = nullptr;
     emitSignalForAllInstances(FRAMELESSHELPER_BYTEARRAY_LITERAL("windowChanged"));
 }
@@ -532,31 +737,46 @@ QWidget *FramelessWidgetsHelperPrivate::findTopLevelWindow() const
     return nullptr;
 }
 
-WidgetsHelperData FramelessWidgetsHelperPrivate::getWindowData() const
+WidgetsHelperDataPtr FramelessWidgetsHelperPrivate::getWindowData() const
 {
-    //Q_ASSERT(m_window);
-    if (!m_window) {
-        return {};
-    }
-    const WId windowId = m_window->winId();
-    const QMutexLocker locker(&g_widgetsHelper()->mutex);
-    if (!g_widgetsHelper()->data.contains(windowId)) {
-        g_widgetsHelper()->data.insert(windowId, {});
+    static const auto emptyData = std::make_shared<const WidgetsHelperData>();
+    const WidgetsHelperWindowData * const windowData = currentWindowData(false);
+    //Q_ASSERT(windowData);
+    if (!windowData) {
+        return emptyData;
+    }
+    // No lock and no copy here, we just grab a reference to the latest snapshot.
+    return loadSnapshot(windowData->snapshot);
+}
+
+WidgetsHelperWindowData *FramelessWidgetsHelperPrivate::currentWindowData(const bool create) const
+{
+    // Another helper instance of the same window may have detached it and dropped
+    // our reference, look the data up by the window ID again in that case.
+    if (!m_windowData && m_window) {
+        const WId windowId = m_window->winId();
+        if (create) {
+            m_windowData = findOrCreateWindowData(windowId);
+        } else {
+            const QMutexLocker locker(&g_widgetsHelper()->mutex);
+            m_windowData = g_widgetsHelper()->data.value(windowId);
+        }
     }
-    return g_widgetsHelper()->data.value(windowId);
+    return m_windowData.get();
 }
 
-WidgetsHelperData *FramelessWidgetsHelperPrivate::getWindowDataMutable() const
+std::shared_ptr<WidgetsHelperWindowData> FramelessWidgetsHelperPrivate::findOrCreateWindowData(const WId windowId)
 {
-    //Q_ASSERT(m_window);
-    if (!m_window) {
+    Q_ASSERT(windowId);
+    if (!windowId) {
         return nullptr;
     }
-    const WId windowId = m_window->winId();
-    if (!g_widgetsHelper()->data.contains(windowId)) {
-        g_widgetsHelper()->data.insert(windowId, {});
+    const QMutexLocker locker(&g_widgetsHelper()->mutex);
+    auto &windowData = g_widgetsHelper()->data[windowId];
+    if (!windowData) {
+        windowData = std::make_shared<WidgetsHelperWindowData>();
     }
-    return &g_widgetsHelper()->data[windowId];
+    return windowData;
 }
 
 QRect FramelessWidgetsHelperPrivate::mapWidgetGeometryToScene(const QWidget * const widget) const
@@ -579,87 +799,107 @@ bool FramelessWidgetsHelperPrivate::isInSystemButtons(const QPoint &pos, SystemB
     if (!button) {
         return false;
     }
-    *button = SystemButtonType::Unknown;
-    const WidgetsHelperData data = getWindowData();
-    if (data.windowIconButton && data.windowIconButton->isVisible() && data.windowIconButton->isEnabled()) {
-        if (data.windowIconButton->geometry().contains(pos)) {
-            *button = SystemButtonType::WindowIcon;
-            return true;
-        }
+    const HitTestResult result = hitTest(pos, false);
+    *button = result.button;
+    return (result.zone == HitTestZone::SystemButton);
+}
+
+bool FramelessWidgetsHelperPrivate::isInTitleBarDraggableArea(const QPoint &pos) const
+{
+    return (hitTest(pos, false).zone == HitTestZone::Caption);
+}
+
+HitTestResult FramelessWidgetsHelperPrivate::classify(const QPoint &pos) const
+{
+    if (!m_window) {
+        return {};
     }
-    if (data.contextHelpButton && data.contextHelpButton->isVisible() && data.contextHelpButton->isEnabled()) {
-        if (data.contextHelpButton->geometry().contains(pos)) {
-            *button = SystemButtonType::Help;
-            return true;
-        }
+    const bool resizable = (Utils::windowStatesToWindowState(m_window->windowState()) == Qt::WindowNoState);
+    return hitTest(pos, resizable);
+}
+
+HitTestResult FramelessWidgetsHelperPrivate::hitTest(const QPoint &pos, const bool resizable) const
+{
+    if (!m_window) {
+        // The FramelessWidgetsHelper object has not been attached to a specific window yet,
+        // so we assume there's no title bar.
+        return {};
     }
-    if (data.minimizeButton && data.minimizeButton->isVisible() && data.minimizeButton->isEnabled()) {
-        if (data.minimizeButton->geometry().contains(pos)) {
-            *button = SystemButtonType::Minimize;
-            return true;
-        }
+    WidgetsHelperWindowData * const windowData = currentWindowData(false);
+    if (!windowData) {
+        return {};
     }
-    if (data.maximizeButton && data.maximizeButton->isVisible() && data.maximizeButton->isEnabled()) {
-        if (data.maximizeButton->geometry().contains(pos)) {
-            *button = SystemButtonType::Maximize;
-            return true;
-        }
+    // Rebuilding the geometry is expensive when the title bar contains a lot of widgets,
+    // so we only do it after one of the tracked widgets has been changed, every other
+    // mouse event only needs a few simple rectangle lookups.
+    if (windowData->hitTestGeometryDirty) {
+        windowData->hitTestGeometryDirty = false;
+        windowData->hitTestGeometry = calculateHitTestGeometry(*loadSnapshot(windowData->snapshot));
     }
-    if (data.closeButton && data.closeButton->isVisible() && data.closeButton->isEnabled()) {
-        if (data.closeButton->geometry().contains(pos)) {
-            *button = SystemButtonType::Close;
-            return true;
-        }
-    }
-    return false;
+    return Utils::classifyHitTestZone(windowData->hitTestGeometry, pos, resizable);
 }
 
-bool FramelessWidgetsHelperPrivate::isInTitleBarDraggableArea(const QPoint &pos) const
+HitTestGeometry FramelessWidgetsHelperPrivate::calculateHitTestGeometry(const WidgetsHelperData &data) const
 {
-    const WidgetsHelperData data = getWindowData();
+    if (!m_window) {
+        return {};
+    }
+    HitTestGeometry geometry = {};
+    geometry.windowSize = m_window->size();
+    const std::pair<SystemButtonType, QWidget *> systemButtons[] = {
+        {SystemButtonType::WindowIcon, data.windowIconButton},
+        {SystemButtonType::Help, data.contextHelpButton},
+        {SystemButtonType::Minimize, data.minimizeButton},
+        {SystemButtonType::Maximize, data.maximizeButton},
+        {SystemButtonType::Close, data.closeButton}
+    };
+    for (auto &&button : std::as_const(systemButtons)) {
+        if (button.second && button.second->isVisible() && button.second->isEnabled()) {
+            geometry.systemButtons.append({button.first, mapWidgetGeometryToScene(button.second)});
+        }
+    }
     if (!data.titleBarWidget) {
         // There's no title bar at all, the mouse will always be in the client area.
-        return false;
+        return geometry;
     }
     if (!data.titleBarWidget->isVisible() || !data.titleBarWidget->isEnabled()) {
         // The title bar is hidden or disabled for some reason, treat it as there's no title bar.
-        return false;
+        return geometry;
     }
-    if (!m_window) {
-        // The FramelessWidgetsHelper object has not been attached to a specific window yet,
-        // so we assume there's no title bar.
-        return false;
-    }
-    const QRect windowRect = {QPoint(0, 0), m_window->size()};
+    const QRect windowRect = {QPoint(0, 0), geometry.windowSize};
     const QRect titleBarRect = mapWidgetGeometryToScene(data.titleBarWidget);
     if (!titleBarRect.intersects(windowRect)) {
         // The title bar is totally outside of the window for some reason,
         // also treat it as there's no title bar.
-        return false;
-    }
-    QRegion region = titleBarRect;
-    const auto systemButtons = {data.windowIconButton, data.contextHelpButton,
-                     data.minimizeButton, data.maximizeButton, data.closeButton};
-    for (auto &&button : std::as_const(systemButtons)) {
-        if (button && button->isVisible() && button->isEnabled()) {
-            region -= mapWidgetGeometryToScene(button);
-        }
+        return geometry;
     }
+    geometry.titleBarRect = titleBarRect;
     if (!data.hitTestVisibleWidgets.isEmpty()) {
         for (auto &&widget : std::as_const(data.hitTestVisibleWidgets)) {
             if (widget && widget->isVisible() && widget->isEnabled()) {
-                region -= mapWidgetGeometryToScene(widget);
+                geometry.hitTestVisibleRects.append(mapWidgetGeometryToScene(widget));
             }
         }
     }
     if (!data.hitTestVisibleRects.isEmpty()) {
         for (auto &&rect : std::as_const(data.hitTestVisibleRects)) {
             if (rect.isValid()) {
-                region -= rect;
+                geometry.hitTestVisibleRects.append(rect);
             }
         }
     }
-    return region.contains(pos);
+    return geometry;
+}
+
+void FramelessWidgetsHelperPrivate::trackWidgetGeometry(QWidget *widget)
+{
+    Q_ASSERT(widget);
+    if (!widget) {
+        return;
+    }
+    if (WidgetsHelperWindowData * const windowData = currentWindowData(true)) {
+        windowData->geometryWatcher->track(widget);
+    }
 }
 
 bool FramelessWidgetsHelperPrivate::shouldIgnoreMouseEvents(const QPoint &pos) const
@@ -688,7 +928,8 @@ void FramelessWidgetsHelperPrivate::setSystemButtonState(const SystemButtonType
     if (button == SystemButtonType::Unknown) {
         return;
     }
-    const WidgetsHelperData data = getWindowData();
+    const WidgetsHelperDataPtr dataPtr = getWindowData();
+    const WidgetsHelperData &data = *dataPtr;
     QWidget *widgetButton = nullptr;
     switch (button) {
     case SystemButtonType::Unknown:
@@ -839,32 +1080,35 @@ void FramelessWidgetsHelperPrivate::setSystemButton(QWidget *widget, const Syste
     if (!widget || (buttonType == SystemButtonType::Unknown)) {
         return;
     }
-    const QMutexLocker locker(&g_widgetsHelper()->mutex);
-    WidgetsHelperData *data = getWindowDataMutable();
-    if (!data) {
+    WidgetsHelperWindowData * const windowData = currentWindowData(true);
+    if (!windowData) {
         return;
     }
-    switch (buttonType) {
-    case SystemButtonType::Unknown:
-        Q_ASSERT(false);
-        break;
-    case SystemButtonType::WindowIcon:
-        data->windowIconButton = widget;
-        break;
-    case SystemButtonType::Help:
-        data->contextHelpButton = widget;
-        break;
-    case SystemButtonType::Minimize:
-        data->minimizeButton = widget;
-        break;
-    case SystemButtonType::Maximize:
-    case SystemButtonType::Restore:
-        data->maximizeButton = widget;
-        break;
-    case SystemButtonType::Close:
-        data->closeButton = widget;
-        break;
-    }
+    modifyWindowData(windowData, [widget, buttonType](WidgetsHelperData &data) -> bool {
+        switch (buttonType) {
+        case SystemButtonType::Unknown:
+            Q_ASSERT(false);
+            return false;
+        case SystemButtonType::WindowIcon:
+            data.windowIconButton = widget;
+            break;
+        case SystemButtonType::Help:
+            data.contextHelpButton = widget;
+            break;
+        case SystemButtonType::Minimize:
+            data.minimizeButton = widget;
+            break;
+        case SystemButtonType::Maximize:
+        case SystemButtonType::Restore:
+            data.maximizeButton = widget;
+            break;
+        case SystemButtonType::Close:
+            data.closeButton = widget;
+            break;
+        }
+        return true;
+    });
+    trackWidgetGeometry(widget);
 }
 
 FramelessWidgetsHelper::FramelessWidgetsHelper(QObject *parent)
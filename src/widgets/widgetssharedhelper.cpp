@@ -24,6 +24,7 @@
 
 #include "widgetssharedhelper_p.h"
 #include <QtCore/qcoreevent.h>
+#include <QtCore/qtimer.h>
 #include <QtGui/qevent.h>
 #include <QtGui/qpainter.h>
 #include <QtGui/qwindow.h>
@@ -55,6 +56,11 @@ Q_LOGGING_CATEGORY(lcWidgetsSharedHelper, "wangwenx190.framelesshelper.widgets.w
 
 using namespace Global;
 
+// How long the window has to stay still before the mica material is realigned,
+// when it's paused while moving.
+static constexpr const int kMicaMoveSettleInterval = 150;
+static constexpr const qreal kDefaultRefreshRate = 60.0;
+
 WidgetsSharedHelper::WidgetsSharedHelper(QObject *parent) : QObject(parent)
 {
 }
@@ -93,6 +99,18 @@ void WidgetsSharedHelper::setup(QWidget *widget)
                 m_targetWidget->update();
             }
         });
+    if (!m_micaRepaintTimer) {
+        m_micaRepaintTimer = new QTimer(this);
+        m_micaRepaintTimer->setSingleShot(true);
+        m_micaRepaintTimer->setTimerType(Qt::PreciseTimer);
+        connect(m_micaRepaintTimer, &QTimer::timeout, this, [this](){
+            // The window has settled down, realign the whole material in one go.
+            m_micaOriginFrozen = false;
+            if (m_targetWidget && m_micaEnabled) {
+                m_targetWidget->update();
+            }
+        });
+    }
     m_targetWidget->installEventFilter(this);
     updateContentsMargins();
     m_targetWidget->update();
@@ -121,6 +139,11 @@ void WidgetsSharedHelper::setMicaEnabled(const bool value)
         return;
     }
     m_micaEnabled = value;
+    m_micaOriginFrozen = false;
+    if (!m_micaEnabled && m_micaMaterial) {
+        // Lets the blurred wallpaper go once no other window needs it either.
+        MicaMaterialPrivate::get(m_micaMaterial)->setActive(false);
+    }
     if (m_targetWidget) {
         m_targetWidget->update();
     }
@@ -165,7 +188,7 @@ bool WidgetsSharedHelper::eventFilter(QObject *object, QEvent *event)
     case QEvent::Move:
     case QEvent::Resize:
         if (m_micaEnabled) {
-            m_targetWidget->update();
+            scheduleMicaRepaint(event->type() == QEvent::Move);
         }
         break;
     default:
@@ -204,19 +227,47 @@ void WidgetsSharedHelper::paintEventHandler(QPaintEvent *event)
         return;
     }
     if (m_micaEnabled && m_micaMaterial) {
+        // While the material is paused, every partial repaint has to use the same origin
+        // as the parts that are already on screen, otherwise they wouldn't line up.
+        if (!m_micaOriginFrozen) {
+            m_micaOrigin = m_targetWidget->mapToGlobal(QPoint(0, 0));
+        }
         QPainter painter(m_targetWidget);
-        m_micaMaterial->paint(&painter, m_targetWidget->size(),
-            m_targetWidget->mapToGlobal(QPoint(0, 0)));
+        m_micaMaterial->paintRegion(&painter, m_targetWidget->size(), m_micaOrigin, event->region());
     }
     if ((Utils::windowStatesToWindowState(m_targetWidget->windowState()) == Qt::WindowNoState)
             && m_borderPainter) {
         QPainter painter(m_targetWidget);
-        m_borderPainter->paint(&painter, m_targetWidget->size(), m_targetWidget->isActiveWindow());
+        m_borderPainter->paintRegion(&painter, m_targetWidget->size(), m_targetWidget->isActiveWindow(), event->region());
     }
     // Don't eat this event here, we need Qt to keep dispatching this paint event
     // otherwise the widget won't paint anything else from the user side.
 }
 
+void WidgetsSharedHelper::scheduleMicaRepaint(const bool moving)
+{
+    Q_ASSERT(m_micaRepaintTimer);
+    if (!m_micaRepaintTimer) {
+        return;
+    }
+    // Leave the wallpaper where it is until the user stops dragging the window around.
+    if (moving && FramelessConfig::instance()->isSet(Option::PauseMicaMaterialWhileMoving)) {
+        // Keep the origin of the last paint, which is where the window was when it
+        // started moving, until the settle timer fires.
+        m_micaOriginFrozen = true;
+        m_micaRepaintTimer->start(kMicaMoveSettleInterval);
+        return;
+    }
+    // The window manager can send us hundreds of move events per second while the
+    // window is being dragged, but there's no point in repainting more than once
+    // per display frame: all the events until then are folded into one repaint.
+    if (m_micaRepaintTimer->isActive()) {
+        return;
+    }
+    const qreal refreshRate = (m_screen ? m_screen->refreshRate() : kDefaultRefreshRate);
+    m_micaRepaintTimer->start(qRound(1000.0 / ((refreshRate > 0.0) ? refreshRate : kDefaultRefreshRate)));
+}
+
 void WidgetsSharedHelper::handleScreenChanged(QScreen *screen)
 {
     Q_ASSERT(m_targetWidget);
@@ -245,7 +296,8 @@ void WidgetsSharedHelper::handleScreenChanged(QScreen *screen)
             }
             m_screenDpr = currentDpr;
             if (m_micaEnabled && m_micaMaterial) {
-                MicaMaterialPrivate::get(m_micaMaterial)->maybeGenerateBlurredWallpaper(true);
+                // Only the tile of this screen is regenerated, at its new resolution.
+                m_targetWidget->update();
             }
         });
 }
@@ -0,0 +1,124 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtGui/qevent.h>
+#include <QtGui/qguiapplication.h>
+#include <QtGui/qwindow.h>
+#include <framelesshelper_qt.h>
+#include <iterator>
+
+FRAMELESSHELPER_USE_NAMESPACE
+
+using namespace Global;
+
+// Measures what FramelessHelperQt's event filter costs per MouseMove event: the same
+// events are sent to a window without and with the filter, the difference is the cost
+// of the filter. Not a test, it's meant to be run by hand on a release build. It only
+// uses SystemParameters, so it can be built against older versions of the library as
+// well, to compare them.
+
+static constexpr const int kEventCount = 1000000;
+static constexpr const int kTitleBarHeight = 30;
+
+[[nodiscard]] static SystemParameters systemParameters(QWindow *window)
+{
+    SystemParameters params = {};
+    params.getWindowFlags = [window]() -> Qt::WindowFlags { return window->flags(); };
+    params.setWindowFlags = [window](const Qt::WindowFlags flags) -> void { window->setFlags(flags); };
+    params.getWindowSize = [window]() -> QSize { return window->size(); };
+    params.setWindowSize = [window](const QSize &size) -> void { window->resize(size); };
+    params.getWindowPosition = [window]() -> QPoint { return window->position(); };
+    params.setWindowPosition = [window](const QPoint &pos) -> void { window->setPosition(pos); };
+    params.getWindowScreen = [window]() -> QScreen * { return window->screen(); };
+    params.isWindowFixedSize = []() -> bool { return false; };
+    params.setWindowFixedSize = [](const bool) -> void {};
+    params.getWindowState = [window]() -> Qt::WindowState { return window->windowState(); };
+    params.setWindowState = [window](const Qt::WindowState state) -> void { window->setWindowState(state); };
+    params.getWindowHandle = [window]() -> QWindow * { return window; };
+    params.windowToScreen = [window](const QPoint &pos) -> QPoint { return window->mapToGlobal(pos); };
+    params.screenToWindow = [window](const QPoint &pos) -> QPoint { return window->mapFromGlobal(pos); };
+    params.isInsideSystemButtons = [](const QPoint &, SystemButtonType *button) -> bool {
+        *button = SystemButtonType::Unknown;
+        return false;
+    };
+    params.isInsideTitleBarDraggableArea = [](const QPoint &pos) -> bool { return (pos.y() < kTitleBarHeight); };
+    params.getWindowDevicePixelRatio = [window]() -> qreal { return window->devicePixelRatio(); };
+    params.setSystemButtonState = [](const SystemButtonType, const ButtonState) -> void {};
+    params.getWindowId = [window]() -> WId { return window->winId(); };
+    params.shouldIgnoreMouseEvents = [](const QPoint &) -> bool { return false; };
+    params.showSystemMenu = [](const QPoint &) -> void {};
+    params.setProperty = [window](const QByteArray &name, const QVariant &value) -> void { window->setProperty(name.constData(), value); };
+    params.getProperty = [window](const QByteArray &name, const QVariant &defaultValue) -> QVariant {
+        const QVariant value = window->property(name.constData());
+        return (value.isValid() ? value : defaultValue);
+    };
+    params.setCursor = [window](const QCursor &cursor) -> void { window->setCursor(cursor); };
+    params.unsetCursor = [window]() -> void { window->unsetCursor(); };
+    params.getWidgetHandle = []() -> QObject * { return nullptr; };
+    return params;
+}
+
+// Nanoseconds per MouseMove event at the given position.
+[[nodiscard]] static double mouseMoveCost(QWindow *window, const QPoint &pos)
+{
+    QMouseEvent event(QEvent::MouseMove, pos, pos, window->mapToGlobal(pos), Qt::NoButton, Qt::NoButton, Qt::NoModifier);
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i != kEventCount; ++i) {
+        QCoreApplication::sendEvent(window, &event);
+    }
+    return (double(timer.nsecsElapsed()) / double(kEventCount));
+}
+
+int main(int argc, char *argv[])
+{
+    FramelessHelper::Core::initialize();
+
+    QGuiApplication application(argc, argv);
+
+    QWindow window;
+    window.resize(800, 600);
+    window.show();
+
+    const struct { const char *name; QPoint pos; } kPositions[] = {
+        {"client area", {400, 300}}, // Nothing to do but classify the position.
+        {"title bar", {400, (kTitleBarHeight / 2)}},
+        {"resize border", {1, 300}} // Sets the resize cursor every time.
+    };
+    double withoutFilter[std::size(kPositions)] = {};
+    for (int i = 0; i != int(std::size(kPositions)); ++i) {
+        withoutFilter[i] = mouseMoveCost(&window, kPositions[i].pos);
+    }
+    FramelessHelperQt::addWindow(systemParameters(&window));
+    for (int i = 0; i != int(std::size(kPositions)); ++i) {
+        const double withFilter = mouseMoveCost(&window, kPositions[i].pos);
+        qInfo().noquote() << kPositions[i].name << ":" << withoutFilter[i] << "ns without the filter,"
+                          << withFilter << "ns with it," << (withFilter - withoutFilter[i]) << "ns per event for the filter";
+    }
+    FramelessHelperQt::removeWindow(window.winId());
+    return 0;
+}
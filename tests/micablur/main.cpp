@@ -0,0 +1,177 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qrandom.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qthreadpool.h>
+#include <QtGui/qimage.h>
+#include <micablur_p.h>
+#include <cstdlib>
+#include <iterator>
+
+FRAMELESSHELPER_USE_NAMESPACE
+
+using namespace Global;
+
+// All of the blur algorithms must give exactly the same result, no matter which row
+// kernel the exponential blur uses and how many threads the work is split across.
+
+static constexpr const QImage::Format kFormats[] = {QImage::Format_ARGB32_Premultiplied, QImage::Format_RGB32};
+// Odd sizes as well, so that the rows which don't fill a whole batch and the chunks
+// which aren't full are covered too.
+static constexpr const QSize kSizes[] = {{1, 1}, {7, 3}, {64, 64}, {333, 97}, {1000, 6}, {1366, 300}};
+static constexpr const qreal kRadii[] = {0.0, 1.0, 5.5, 32.0, 128.0};
+
+[[nodiscard]] static QImage randomImage(QRandomGenerator &random, const QSize &size, const QImage::Format format)
+{
+    QImage image(size, format);
+    for (int y = 0; y != size.height(); ++y) {
+        auto line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x != size.width(); ++x) {
+            const int alpha = ((format == QImage::Format_RGB32) ? 255 : random.bounded(256));
+            // Premultiplied: no channel may be larger than the alpha.
+            line[x] = qRgba(random.bounded(alpha + 1), random.bounded(alpha + 1), random.bounded(alpha + 1), alpha);
+        }
+    }
+    return image;
+}
+
+[[nodiscard]] static QImage exponentialBlurred(const QImage &source, const MicaBlur::RowKernel kernel, const qreal radius, const bool improvedQuality)
+{
+    QImage image = source.copy();
+    MicaBlur::setRowKernel(kernel);
+    MicaBlur::exponentialBlur(image, radius, improvedQuality);
+    MicaBlur::setRowKernel(MicaBlur::RowKernel::Auto);
+    return image;
+}
+
+// Every variant of every algorithm, "variant" counts up from zero until an invalid image is returned.
+[[nodiscard]] static QImage blurred(const QImage &source, const int variant, const qreal radius, const char **name)
+{
+    static constexpr const MicaBlurQuality kQualities[] = {MicaBlurQuality::Speed, MicaBlurQuality::Balanced, MicaBlurQuality::Quality};
+    QImage image = source.copy();
+    switch (variant) {
+    case 0:
+    case 1:
+        *name = "exponential";
+        MicaBlur::exponentialBlur(image, radius, (variant == 1));
+        return image;
+    case 2:
+    case 3:
+    case 4:
+        *name = "box";
+        if (image.format() == QImage::Format_ARGB32_Premultiplied) {
+            MicaBlur::boxBlur(image, radius, variant);
+        }
+        return image;
+    case 5:
+    case 6:
+    case 7:
+        *name = "dual kawase";
+        if (image.format() == QImage::Format_ARGB32_Premultiplied) {
+            return MicaBlur::kawaseBlur(image, radius, kQualities[variant - 5]);
+        }
+        return image;
+    default:
+        break;
+    }
+    return {};
+}
+
+[[nodiscard]] static int compareRowKernels(QRandomGenerator &random, int &checks)
+{
+    static constexpr const MicaBlur::RowKernel kKernels[] = {MicaBlur::RowKernel::SSE2, MicaBlur::RowKernel::AVX2};
+    static constexpr const char *kKernelNames[] = {"SSE2", "AVX2"};
+    int failures = 0;
+    for (int k = 0; k != int(std::size(kKernels)); ++k) {
+        if (!MicaBlur::isRowKernelSupported(kKernels[k])) {
+            qInfo() << kKernelNames[k] << "is not supported by this build or CPU, skipped.";
+            continue;
+        }
+        for (auto &&format : kFormats) {
+            for (auto &&size : kSizes) {
+                const QImage source = randomImage(random, size, format);
+                for (auto &&radius : kRadii) {
+                    for (const bool improvedQuality : {false, true}) {
+                        const QImage expected = exponentialBlurred(source, MicaBlur::RowKernel::Scalar, radius, improvedQuality);
+                        const QImage actual = exponentialBlurred(source, kKernels[k], radius, improvedQuality);
+                        ++checks;
+                        if (actual != expected) {
+                            ++failures;
+                            qCritical() << kKernelNames[k] << "differs from the scalar kernel:" << format
+                                        << size << "radius" << radius << "improved quality" << improvedQuality;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return failures;
+}
+
+[[nodiscard]] static int compareThreadCounts(QRandomGenerator &random, int &checks)
+{
+    QThreadPool * const pool = MicaBlur::threadPool();
+    const int defaultThreadCount = pool->maxThreadCount();
+    // More threads than cores is fine, the chunks are still split up and interleaved.
+    const int threadCount = qMax(4, QThread::idealThreadCount());
+    int failures = 0;
+    for (auto &&format : kFormats) {
+        for (auto &&size : kSizes) {
+            const QImage source = randomImage(random, size, format);
+            for (auto &&radius : kRadii) {
+                const char *name = nullptr;
+                for (int variant = 0;; ++variant) {
+                    pool->setMaxThreadCount(1);
+                    const QImage expected = blurred(source, variant, radius, &name);
+                    if (expected.isNull()) {
+                        break;
+                    }
+                    pool->setMaxThreadCount(threadCount);
+                    const QImage actual = blurred(source, variant, radius, &name);
+                    ++checks;
+                    if (actual != expected) {
+                        ++failures;
+                        qCritical() << name << "blur differs between 1 and" << threadCount << "threads:" << format
+                                    << size << "radius" << radius << "variant" << variant;
+                    }
+                }
+            }
+        }
+    }
+    pool->setMaxThreadCount(defaultThreadCount);
+    return failures;
+}
+
+int main()
+{
+    QRandomGenerator random(20230101);
+    int checks = 0;
+    int failures = compareRowKernels(random, checks);
+    failures += compareThreadCounts(random, checks);
+    qInfo() << checks << "comparisons," << failures << "failures.";
+    return ((failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qrandom.h>
+#include <QtCore/qthreadpool.h>
+#include <QtGui/qimage.h>
+#include <QtGui/qpainter.h>
+#include <micablur_p.h>
+#include <algorithm>
+#include <iterator>
+
+FRAMELESSHELPER_USE_NAMESPACE
+
+using namespace Global;
+
+// Measures how long every blur algorithm and quality takes for a radius 128 blur of a
+// whole screen, including painting the result. Not a test, it's meant to be run by hand
+// on a release build.
+
+static constexpr const qreal kBlurRadius = 128.0; // kDefaultBlurRadius
+static constexpr const int kRuns = 5;
+
+[[nodiscard]] static QImage randomImage(const QSize &size)
+{
+    QRandomGenerator random(20230101);
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y != size.height(); ++y) {
+        auto line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x != size.width(); ++x) {
+            line[x] = (random.generate() | 0xff000000);
+        }
+    }
+    return image;
+}
+
+int main()
+{
+    static constexpr const QSize kSizes[] = {{1920, 1080}, {3840, 2160}, {7680, 4320}};
+    static constexpr const MicaBlurAlgorithm kAlgorithms[] = {MicaBlurAlgorithm::Exponential, MicaBlurAlgorithm::Box, MicaBlurAlgorithm::DualKawase};
+    static constexpr const char *kAlgorithmNames[] = {"exponential", "box", "dual kawase"};
+    static constexpr const MicaBlurQuality kQualities[] = {MicaBlurQuality::Speed, MicaBlurQuality::Balanced, MicaBlurQuality::Quality};
+    static constexpr const char *kQualityNames[] = {"speed", "balanced", "quality"};
+    qInfo() << "Blur threads:" << MicaBlur::threadPool()->maxThreadCount() << "| median of" << kRuns << "runs";
+    for (auto &&size : kSizes) {
+        const QImage source = randomImage(size);
+        for (int a = 0; a != int(std::size(kAlgorithms)); ++a) {
+            for (int q = 0; q != int(std::size(kQualities)); ++q) {
+                qint64 nsecs[kRuns] = {};
+                for (int run = 0; run != kRuns; ++run) {
+                    QImage image = source.copy();
+                    QImage result(size, QImage::Format_ARGB32_Premultiplied);
+                    QElapsedTimer timer;
+                    timer.start();
+                    {
+                        QPainter painter(&result);
+                        painter.setRenderHints(QPainter::Antialiasing |
+                            QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
+                        MicaBlur::blurImage(&painter, image, kBlurRadius, kAlgorithms[a], kQualities[q]);
+                    }
+                    nsecs[run] = timer.nsecsElapsed();
+                }
+                std::sort(std::begin(nsecs), std::end(nsecs));
+                qInfo().noquote() << size << kAlgorithmNames[a] << kQualityNames[q] << ":"
+                                  << (double(nsecs[kRuns / 2]) / 1000000.0) << "ms";
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/qcoreapplication.h>
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qrandom.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtGui/qimage.h>
+#include <QtGui/qimagereader.h>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+// Compares the two ways of getting a wallpaper down to the size of a mica tile: decoding
+// it at full resolution and scaling it down afterwards, which is what MicaMaterial used
+// to do, and letting QImageReader decode it straight at the tile size, which is what it
+// does now. Not a test, it's meant to be run by hand on a release build:
+//
+//   MicaDecodeBenchmark [--old | --new] [image files...]
+//
+// Without any files, an 8K JPEG and PNG are generated. "--old" and "--new" only run one
+// of the two, so that the peak memory of the process (/usr/bin/time -v, for example)
+// belongs to that one alone.
+
+static constexpr const QSize kTileSize = {480, 270}; // A 1080p screen, at a quarter of its resolution.
+static constexpr const QSize kGeneratedSize = {7680, 4320};
+static constexpr const int kRuns = 5;
+
+// Something like a photo, so that the encoders can't make it unrealistically small.
+[[nodiscard]] static QImage syntheticWallpaper()
+{
+    QRandomGenerator random(20230101);
+    QImage image(kGeneratedSize, QImage::Format_RGB32);
+    const int w = kGeneratedSize.width();
+    const int h = kGeneratedSize.height();
+    for (int y = 0; y != h; ++y) {
+        auto line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x != w; ++x) {
+            const int noise = (random.bounded(33) - 16);
+            line[x] = qRgb(qBound(0, ((x * 255 / w) + noise), 255), qBound(0, ((y * 255 / h) + noise), 255),
+                           qBound(0, ((((x / 64) + (y / 64)) % 2) * 128 + noise + 64), 255));
+        }
+    }
+    return image;
+}
+
+// The centered part of the wallpaper that fills the tile, like WallpaperAspectStyle::Fill.
+[[nodiscard]] static QRect fillClipRect(const QSize &scaledSize)
+{
+    return {((scaledSize.width() - kTileSize.width()) / 2), ((scaledSize.height() - kTileSize.height()) / 2),
+            kTileSize.width(), kTileSize.height()};
+}
+
+[[nodiscard]] static QImage decodeFullThenScale(const QString &filePath, qsizetype *heldBytes)
+{
+    const QImage image(filePath);
+    const QImage scaled = image.scaled(kTileSize, Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation);
+    *heldBytes = (image.sizeInBytes() + scaled.sizeInBytes());
+    return scaled.copy(fillClipRect(scaled.size()));
+}
+
+[[nodiscard]] static QImage decodeScaled(const QString &filePath, qsizetype *heldBytes)
+{
+    QImageReader reader(filePath);
+    const QSize scaledSize = reader.size().scaled(kTileSize, Qt::KeepAspectRatioByExpanding);
+    reader.setScaledSize(scaledSize);
+    reader.setScaledClipRect(fillClipRect(scaledSize));
+    const QImage image = reader.read();
+    *heldBytes = image.sizeInBytes();
+    return image;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication application(argc, argv);
+    QStringList arguments = QCoreApplication::arguments().mid(1);
+    const bool runOld = !arguments.contains(QStringLiteral("--new"));
+    const bool runNew = !arguments.contains(QStringLiteral("--old"));
+    arguments.removeAll(QStringLiteral("--old"));
+    arguments.removeAll(QStringLiteral("--new"));
+
+    QTemporaryDir temporaryDir;
+    if (arguments.isEmpty()) {
+        const QImage wallpaper = syntheticWallpaper();
+        for (auto &&suffix : {"jpg", "png"}) {
+            const QString filePath = QDir(temporaryDir.path()).filePath(QStringLiteral("wallpaper.") + QLatin1String(suffix));
+            if (!wallpaper.save(filePath, nullptr, 90)) {
+                qCritical() << "Failed to write" << filePath;
+                return -1;
+            }
+            arguments.append(filePath);
+        }
+    }
+
+    using Decoder = QImage(*)(const QString &, qsizetype *);
+    const struct { const char *name; bool enabled; Decoder decoder; } kMethods[] = {
+        {"full decode + scaled()", runOld, decodeFullThenScale},
+        {"QImageReader::setScaledSize()", runNew, decodeScaled}
+    };
+    for (auto &&filePath : std::as_const(arguments)) {
+        const QImageReader reader(filePath);
+        qInfo().noquote() << QDir::toNativeSeparators(filePath) << reader.format() << reader.size();
+        for (auto &&method : kMethods) {
+            if (!method.enabled) {
+                continue;
+            }
+            qint64 nsecs[kRuns] = {};
+            qsizetype heldBytes = 0;
+            for (int run = 0; run != kRuns; ++run) {
+                QElapsedTimer timer;
+                timer.start();
+                const QImage image = method.decoder(filePath, &heldBytes);
+                nsecs[run] = timer.nsecsElapsed();
+                if (image.isNull()) {
+                    qCritical() << "Failed to decode" << filePath;
+                    return -1;
+                }
+            }
+            std::sort(std::begin(nsecs), std::end(nsecs));
+            qInfo().noquote() << "   " << method.name << ":" << (double(nsecs[kRuns / 2]) / 1000000.0)
+                              << "ms, images held:" << (heldBytes / 1024) << "KiB";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qrandom.h>
+#include <QtGui/qimage.h>
+#include <QtGui/qpainter.h>
+#include <micablur_p.h>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+
+FRAMELESSHELPER_USE_NAMESPACE
+
+using namespace Global;
+
+// MicaMaterial keeps the blurred wallpaper of a screen at a quarter of the screen's
+// resolution and scales it up with bilinear filtering when painting. This compares that
+// against blurring at full resolution: the memory the tile needs, the time the blur takes,
+// and how far apart the two results are. A PSNR above 40 dB is not visible at all.
+
+static constexpr const qreal kBlurRadius = 128.0; // kDefaultBlurRadius
+static constexpr const int kDownscaleFactor = 4; // kWallpaperDownscaleFactor
+static constexpr const double kMinimumPsnr = 40.0;
+
+// A worst case for the down-scaling: smooth gradients like a photo, plus hard edges and
+// strong per-pixel noise, which only exist at full resolution.
+[[nodiscard]] static QImage syntheticWallpaper(const QSize &size)
+{
+    QRandomGenerator random(20230101);
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    const int w = size.width();
+    const int h = size.height();
+    for (int y = 0; y != h; ++y) {
+        auto line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x != w; ++x) {
+            const bool stripe = ((((x / 97) + (y / 61)) % 3) == 0);
+            const int noise = (random.bounded(65) - 32);
+            const int r = qBound(0, ((x * 255 / w) + noise + (stripe ? 60 : 0)), 255);
+            const int g = qBound(0, ((y * 255 / h) + noise), 255);
+            const int b = qBound(0, ((((x + y) * 255) / (w + h)) + noise - (stripe ? 60 : 0)), 255);
+            line[x] = qRgba(r, g, b, 255);
+        }
+    }
+    return image;
+}
+
+// What MicaMaterial does for one screen: shrink the wallpaper to the tile size and blur
+// it with the radius scaled down by the same factor.
+[[nodiscard]] static QImage blurredTile(const QImage &wallpaper, const int scale,
+    const MicaBlurAlgorithm algorithm, qint64 *nsecs)
+{
+    QImage buffer = ((scale == 1) ? wallpaper.copy() : wallpaper.scaled((wallpaper.width() / scale),
+        (wallpaper.height() / scale), Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+    QImage tile(buffer.size(), QImage::Format_ARGB32_Premultiplied);
+    tile.fill(0u);
+    QElapsedTimer timer;
+    timer.start();
+    {
+        QPainter painter(&tile);
+        painter.setRenderHints(QPainter::Antialiasing |
+            QPainter::TextAntialiasing | QPainter::SmoothPixmapTransform);
+        MicaBlur::blurImage(&painter, buffer, (kBlurRadius / qreal(scale)), algorithm, MicaBlurQuality::Balanced);
+    }
+    *nsecs = timer.nsecsElapsed();
+    return tile;
+}
+
+[[nodiscard]] static double psnr(const QImage &a, const QImage &b, int *maxDifference)
+{
+    Q_ASSERT(a.size() == b.size());
+    double sum = 0.0;
+    *maxDifference = 0;
+    for (int y = 0; y != a.height(); ++y) {
+        const auto lineA = reinterpret_cast<const QRgb *>(a.constScanLine(y));
+        const auto lineB = reinterpret_cast<const QRgb *>(b.constScanLine(y));
+        for (int x = 0; x != a.width(); ++x) {
+            for (int c = 0; c != 4; ++c) {
+                const int difference = std::abs(int((lineA[x] >> (c * 8)) & 0xff) - int((lineB[x] >> (c * 8)) & 0xff));
+                *maxDifference = qMax(*maxDifference, difference);
+                sum += (difference * difference);
+            }
+        }
+    }
+    const double mse = (sum / (double(a.width()) * double(a.height()) * 4.0));
+    return ((mse <= 0.0) ? 99.0 : (10.0 * std::log10((255.0 * 255.0) / mse)));
+}
+
+int main()
+{
+    static constexpr const QSize kScreenSizes[] = {{1920, 1080}, {3840, 2160}};
+    static constexpr const MicaBlurAlgorithm kAlgorithms[] = {MicaBlurAlgorithm::Exponential, MicaBlurAlgorithm::Box, MicaBlurAlgorithm::DualKawase};
+    static constexpr const char *kAlgorithmNames[] = {"exponential", "box", "dual kawase"};
+    int failures = 0;
+    for (auto &&screenSize : kScreenSizes) {
+        const QImage wallpaper = syntheticWallpaper(screenSize);
+        for (int i = 0; i != int(std::size(kAlgorithms)); ++i) {
+            qint64 fullNsecs = 0;
+            qint64 scaledNsecs = 0;
+            const QImage full = blurredTile(wallpaper, 1, kAlgorithms[i], &fullNsecs);
+            const QImage scaled = blurredTile(wallpaper, kDownscaleFactor, kAlgorithms[i], &scaledNsecs);
+            const QImage upscaled = scaled.scaled(full.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+            int maxDifference = 0;
+            const double quality = psnr(full, upscaled, &maxDifference);
+            qInfo().noquote() << screenSize << kAlgorithmNames[i]
+                              << "| tile:" << (full.sizeInBytes() / 1024) << "KiB ->" << (scaled.sizeInBytes() / 1024) << "KiB"
+                              << "| blur:" << (fullNsecs / 1000000) << "ms ->" << (scaledNsecs / 1000000) << "ms"
+                              << "| PSNR:" << quality << "dB, max difference" << maxDifference;
+            if (quality < kMinimumPsnr) {
+                ++failures;
+                qCritical() << "The down-scaled tile differs visibly from the full resolution one.";
+            }
+        }
+    }
+    return ((failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
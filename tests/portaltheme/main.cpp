@@ -0,0 +1,252 @@
+/*
+ * MIT License
+ *
+ * Copyright (C) 2021-2023 by wangwenx190 (Yuhang Zhao)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <QtCore/qdebug.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qelapsedtimer.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qtemporarydir.h>
+#include <QtCore/qthread.h>
+#include <QtGui/qguiapplication.h>
+#include <QtDBus/qdbusconnection.h>
+#include <QtDBus/qdbuscontext.h>
+#include <QtDBus/qdbusextratypes.h>
+#include <framelessmanager.h>
+#include <framelessmanager_p.h>
+#include <atomic>
+#include <memory>
+
+FRAMELESSHELPER_USE_NAMESPACE
+
+// Checks how FramelessManager caches the desktop theme against a stub XDG desktop portal:
+// when the portal is asked, that a change of the GTK settings.ini or of the portal makes
+// it ask again, that nothing else in the config directory does, and that the cache isn't
+// locked while the portal is being asked. Not part of the CTest run, the stub needs the
+// portal's well known name, so it's meant to be run by hand on a private session bus:
+//
+//   dbus-run-session -- ./PortalThemeTest
+//
+// The GTK backend is disabled through its environment variable, and the XDG config
+// directories point to an empty temporary directory, so that only the stub is asked.
+
+static constexpr const char kPortalService[] = "org.freedesktop.portal.Desktop";
+static constexpr const char kPortalPath[] = "/org/freedesktop/portal/desktop";
+static constexpr const char kAppearanceNamespace[] = "org.freedesktop.appearance";
+static constexpr const char kColorSchemeKey[] = "color-scheme";
+
+class StubPortalSettings : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.portal.Settings")
+
+public:
+    // QtDBus only relays the signals that are emitted in the thread of the object, and
+    // the object has to be registered from there as well, so these run in that thread.
+    bool registerOnBus()
+    {
+        m_bus = std::make_unique<QDBusConnection>(QDBusConnection::connectToBus(
+            QDBusConnection::SessionBus, QStringLiteral("PortalThemeTestStub")));
+        return (m_bus->registerObject(QLatin1String(kPortalPath), this,
+                    QDBusConnection::ExportAllSlots | QDBusConnection::ExportAllSignals)
+                && m_bus->registerService(QLatin1String(kPortalService)));
+    }
+
+    void unregisterFromBus()
+    {
+        m_bus->unregisterService(QLatin1String(kPortalService));
+        m_bus->unregisterObject(QLatin1String(kPortalPath));
+        m_bus.reset();
+        QDBusConnection::disconnectFromBus(QStringLiteral("PortalThemeTestStub"));
+    }
+
+    std::atomic_int reads = 0;
+    std::atomic_uint colorScheme = 0; // 1 means dark, 2 means light.
+    std::atomic_int delay = 0; // Milliseconds every Read call takes.
+
+public Q_SLOTS:
+    QDBusVariant Read(const QString &ns, const QString &key)
+    {
+        ++reads;
+        if (delay > 0) {
+            QThread::msleep(delay);
+        }
+        if ((ns == QLatin1String(kAppearanceNamespace)) && (key == QLatin1String(kColorSchemeKey))) {
+            // "Read" wraps the value in one more variant than "ReadOne" does.
+            return QDBusVariant(QVariant::fromValue(QDBusVariant(uint(colorScheme))));
+        }
+        sendErrorReply(QStringLiteral("org.freedesktop.portal.Error.NotFound"), QStringLiteral("Requested setting not found"));
+        return {};
+    }
+
+Q_SIGNALS:
+    void SettingChanged(const QString &ns, const QString &key, const QDBusVariant &value);
+
+private:
+    std::unique_ptr<QDBusConnection> m_bus = nullptr;
+};
+
+static int g_failures = 0;
+
+static void check(const bool condition, const char *what)
+{
+    qInfo().noquote() << (condition ? "PASS:" : "FAIL:") << what;
+    if (!condition) {
+        ++g_failures;
+    }
+}
+
+// Gives the file system watcher and the bus some time to deliver their notifications.
+static void processEventsFor(const int milliseconds)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < milliseconds) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 10);
+        QThread::msleep(5);
+    }
+}
+
+static bool writeFile(const QString &filePath, const QByteArray &data)
+{
+    QFile file(filePath);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        return false;
+    }
+    return (file.write(data) == data.size());
+}
+
+int main(int argc, char *argv[])
+{
+    QTemporaryDir configDir;
+    if (!configDir.isValid()) {
+        qCritical() << "Failed to create a temporary directory.";
+        return -1;
+    }
+    qputenv("XDG_CONFIG_HOME", QFile::encodeName(configDir.path()));
+    qputenv("XDG_CONFIG_DIRS", QFile::encodeName(configDir.filePath(QStringLiteral("system"))));
+    qputenv(kDisableGtkThemeBackendVar.constData(), "1");
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    FramelessHelper::Core::initialize();
+
+    const QGuiApplication application(argc, argv);
+
+    if (!QDBusConnection::sessionBus().isConnected()) {
+        qCritical() << "No session bus, run me inside \"dbus-run-session\".";
+        return -1;
+    }
+
+    // The library makes blocking calls on its own connection from the GUI thread, so the
+    // stub needs a connection and a thread of its own to be able to answer them.
+    QThread stubThread;
+    stubThread.start();
+    auto stub = new StubPortalSettings;
+    stub->colorScheme = 1;
+    stub->moveToThread(&stubThread);
+    bool registered = false;
+    QMetaObject::invokeMethod(stub, [stub, &registered](){ registered = stub->registerOnBus(); }, Qt::BlockingQueuedConnection);
+    if (!registered) {
+        qCritical() << "Failed to register the stub portal, is a real one running on this bus? Run me inside \"dbus-run-session\".";
+        stubThread.quit();
+        stubThread.wait();
+        delete stub;
+        return -1;
+    }
+
+    // Starts watching the portal and settings.ini, and reads the theme once.
+    FramelessManager::instance();
+    check(FramelessManagerPrivate::desktopPrefersDarkTheme(), "The color scheme of the portal is used.");
+    int reads = stub->reads;
+    check(reads > 0, "The portal has been asked.");
+    check(FramelessManagerPrivate::desktopPrefersDarkTheme(), "The cached value is still the same.");
+    check(stub->reads == reads, "The cached value is used while nothing has changed.");
+
+    // gtk-3.0 doesn't exist yet, so the whole config directory is watched.
+    writeFile(configDir.filePath(QStringLiteral("unrelated.conf")), "x");
+    processEventsFor(500);
+    check(stub->reads == reads, "Changes of other files in the config directory are ignored.");
+
+    QDir(configDir.path()).mkdir(QStringLiteral("gtk-3.0"));
+    processEventsFor(500);
+    check(stub->reads == reads, "Creating gtk-3.0 alone doesn't change anything.");
+
+    const QString settingsIniPath = configDir.filePath(QStringLiteral("gtk-3.0/settings.ini"));
+    writeFile(settingsIniPath, "[Settings]\ngtk-application-prefer-dark-theme=false\n");
+    processEventsFor(500);
+    check(stub->reads > reads, "Creating gtk-3.0/settings.ini is noticed.");
+    reads = stub->reads;
+
+    writeFile(configDir.filePath(QStringLiteral("unrelated.conf")), "xy");
+    processEventsFor(500);
+    check(stub->reads == reads, "Once gtk-3.0 exists, the config directory isn't watched any more.");
+
+    writeFile(settingsIniPath, "[Settings]\ngtk-application-prefer-dark-theme=true\n");
+    processEventsFor(500);
+    check(stub->reads > reads, "Changing settings.ini is noticed.");
+    reads = stub->reads;
+
+    stub->colorScheme = 2;
+    QMetaObject::invokeMethod(stub, [stub](){
+        Q_EMIT stub->SettingChanged(QLatin1String(kAppearanceNamespace), QLatin1String(kColorSchemeKey), QDBusVariant(uint(2)));
+    }, Qt::BlockingQueuedConnection);
+    processEventsFor(500);
+    check(stub->reads > reads, "The SettingChanged signal of the portal is noticed.");
+    check(!FramelessManagerPrivate::desktopPrefersDarkTheme(), "The new color scheme is used.");
+
+    // While one thread waits for a slow portal, the cache must stay usable for the others.
+    stub->delay = 300;
+    FramelessManagerPrivate::invalidateDesktopThemeCache();
+    reads = stub->reads;
+    QThread * const reader = QThread::create([](){
+        Q_UNUSED(FramelessManagerPrivate::desktopPrefersDarkTheme());
+    });
+    reader->start();
+    QElapsedTimer timer;
+    timer.start();
+    while ((stub->reads == reads) && (timer.elapsed() < 5000)) {
+        QThread::msleep(1);
+    }
+    timer.restart();
+    FramelessManagerPrivate::invalidateDesktopThemeCache();
+    const qint64 invalidateTime = timer.elapsed();
+    check(invalidateTime < 100, "The cache isn't locked while the portal is being asked.");
+    reader->wait();
+    delete reader;
+    stub->delay = 0;
+    reads = stub->reads;
+    Q_UNUSED(FramelessManagerPrivate::desktopPrefersDarkTheme());
+    check(stub->reads > reads, "Values asked for before the cache was invalidated aren't kept.");
+
+    QMetaObject::invokeMethod(stub, [stub](){ stub->unregisterFromBus(); }, Qt::BlockingQueuedConnection);
+    stubThread.quit();
+    stubThread.wait();
+    delete stub;
+
+    qInfo() << g_failures << "check(s) failed.";
+    return ((g_failures == 0) ? 0 : 1);
+}
+
+#include "main.moc"